@@ -8,6 +8,22 @@
 Command-line options:
  - "-s" : module report will be separated by semester (encoded as 5th character of module name)
  - "-p" : shows input file parameters and quits.
+ - "--threads N" : parses the input file with N threads (0: one per hardware thread)
+ - "--no-cache" : does not use nor write the snapshot file (see saveSnapshot())
+ - "--batch" : all the following arguments are input files (or folders holding .csv input files), processed concurrently
+ (the output files of input files having the same name are prefixed by their folder, see batchRootPrefixes())
+ - "--jobs N" : number of files processed simultaneously in batch mode (default: one per hardware thread)
+ - "--combined" : in batch mode, also writes the cross-file instructor data (see writeCombined())
+ - "--serve" : loads the input file and answers queries on a Unix socket, until interrupted (see runServer())
+ - "--socket path" : socket used with "--serve" (default: adepopro.sock)
+ - "--weeks A-B" : output files only cover weeks A to B (see Data::restrictToWeeks())
+ - "--conflicts" : also writes the list of overlapping events of a same instructor or room (see writeConflicts())
+ - "--rooms" : also writes the room occupancy report (see writeRooms())
+ - "--reports=E,M,ME,EM" : writes only the given output files, and only computes what they need (see Data::select()),
+ "EW" and "MW" add the instructors (resp. modules) by week files (see Data::writeWeekly())
+ - "--diff old.csv" : compares \c old.csv with the input file, and writes only the resources that have changed (see processDiff())
+ - "--atomic" : each output file is written to a temporary file, renamed when complete (see OutBuffer)
+ - "--stats" : also writes statistics on the run (timings, line counts, container sizes) as a JSON file (see writeStats())
 
  \todo fix the count of characters when utf8 (or other ?) encoding
 */
@@ -16,16 +32,54 @@ Command-line options:
 #include <ctime>
 #include <array>
 #include <map>
-#include <set>
+#include <deque>
+#include <cstdint>
 #include <cassert>
+#include <cmath>
+#include <cctype>
+#include <limits>
+#include <stdexcept>
 #include <algorithm>
-#include <iomanip>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+#include <tuple>
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define ADEPOPRO_HAS_MMAP
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/resource.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <poll.h>
+	#include <csignal>
+	#include <cerrno>
+	#define ADEPOPRO_HAS_UNIX_SOCKET  // see runServer()
+#endif
+
+#if ( defined(__x86_64__) || defined(__i386__) ) && defined(__GNUC__) && !defined(ADEPOPRO_NO_SIMD)
+	#define ADEPOPRO_HAS_X86_SIMD     // SSE2/AVX2 versions of scanSeparators(), selected at runtime
+	#include <immintrin.h>
+#endif
 
-#include <boost/format.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 
@@ -36,13 +90,9 @@ std::string g_rule = "**************************************\n";
 //-------------------------------------------------------------------
 enum EN_WeekDay { WD_LUN, WD_MAR, WD_MER, WD_JEU, WD_VEN };
 
-std::map<std::string,EN_WeekDay> g_daymap = {
-	{ "Lundi",    WD_LUN },
-	{ "Mardi",    WD_MAR },
-	{ "Mercredi", WD_MER },
-	{ "Jeudi",    WD_JEU },
-	{ "Vendredi", WD_VEN }
-};
+/// Day names, index: EN_WeekDay
+const std::array<const char*,5> g_dayNames = { "Lundi", "Mardi", "Mercredi", "Jeudi", "Vendredi" };
+
 
 //-------------------------------------------------------------------
 /// General string tokenizer, taken from http://stackoverflow.com/a/236803/193789
@@ -65,47 +115,595 @@ split_string( const std::string &s, char delim )
 	return velems;
 }
 //-------------------------------------------------------------------
+/// Zero-copy version of split_string(): fills \c fields with views on \c line
+/**
+Follows the same rules as split_string() (an empty line has no fields,
+a trailing delimiter adds an empty field), but stops scanning once \c nbMax fields have been found,
+so the columns that are not needed are never looked at.
+
+\c fields is reused between calls, so that no allocation happens once it has reached its capacity.
+*/
+void
+split_view( std::string_view line, char delim, std::vector<std::string_view>& fields, size_t nbMax )
+{
+	fields.clear();
+	if( line.empty() )
+		return;
+	size_t start = 0;
+	while( fields.size() < nbMax )
+	{
+		auto pos = line.find( delim, start );
+		if( pos == std::string_view::npos )
+		{
+			fields.push_back( line.substr( start ) );
+			break;
+		}
+		fields.push_back( line.substr( start, pos-start ) );
+		start = pos+1;
+	}
+}
+//-------------------------------------------------------------------
+/// Scalar version of scanSeparators(), starting at position \c from
+size_t
+scanSeparators_scalar( const char* data, size_t size, char delim, uint32_t* out, size_t from=0 )
+{
+	size_t nb = 0;
+	for( size_t i=from; i<size; i++ )
+		if( data[i] == delim || data[i] == '\n' )
+			out[nb++] = static_cast<uint32_t>( i );
+	return nb;
+}
+
+#ifdef ADEPOPRO_HAS_X86_SIMD
+//-------------------------------------------------------------------
+/// SSE2 version of scanSeparators(): 16 bytes compared at once, positions read from the movemask
+__attribute__((target("sse2")))
+size_t
+scanSeparators_sse2( const char* data, size_t size, char delim, uint32_t* out )
+{
+	const __m128i v_delim = _mm_set1_epi8( delim );
+	const __m128i v_eol   = _mm_set1_epi8( '\n' );
+	size_t nb = 0;
+	size_t i  = 0;
+	for( ; i+16 <= size; i+=16 )
+	{
+		__m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data+i ) );
+		unsigned mask = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( v, v_delim ), _mm_cmpeq_epi8( v, v_eol ) ) );
+		for( ; mask; mask &= mask-1 )
+			out[nb++] = static_cast<uint32_t>( i + __builtin_ctz( mask ) );
+	}
+	return nb + scanSeparators_scalar( data, size, delim, out+nb, i );
+}
+//-------------------------------------------------------------------
+/// AVX2 version of scanSeparators(), 32 bytes at once
+__attribute__((target("avx2")))
+size_t
+scanSeparators_avx2( const char* data, size_t size, char delim, uint32_t* out )
+{
+	const __m256i v_delim = _mm256_set1_epi8( delim );
+	const __m256i v_eol   = _mm256_set1_epi8( '\n' );
+	size_t nb = 0;
+	size_t i  = 0;
+	for( ; i+32 <= size; i+=32 )
+	{
+		__m256i v = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data+i ) );
+		uint32_t mask = static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_or_si256( _mm256_cmpeq_epi8( v, v_delim ), _mm256_cmpeq_epi8( v, v_eol ) ) ) );
+		for( ; mask; mask &= mask-1 )
+			out[nb++] = static_cast<uint32_t>( i + __builtin_ctz( mask ) );
+	}
+	return nb + scanSeparators_scalar( data, size, delim, out+nb, i );
+}
+#endif // ADEPOPRO_HAS_X86_SIMD
+
+//-------------------------------------------------------------------
+/// Signature of the scanSeparators() versions
+typedef size_t (*ScanSeparatorsFunc)( const char* data, size_t size, char delim, uint32_t* out );
+
+/// Stores in \c out the positions of all the \c delim and newline characters of \c data, in increasing order, and returns their number
+/**
+\c out must have room for \c size values.
+The fastest version supported by the CPU is selected on first call (AVX2, SSE2, or scalar).
+*/
+size_t
+scanSeparators( const char* data, size_t size, char delim, uint32_t* out )
+{
+	static const ScanSeparatorsFunc func = []() -> ScanSeparatorsFunc    // lambda
+	{
+#ifdef ADEPOPRO_HAS_X86_SIMD
+		__builtin_cpu_init();
+		if( __builtin_cpu_supports( "avx2" ) )
+			return scanSeparators_avx2;
+		if( __builtin_cpu_supports( "sse2" ) )
+			return scanSeparators_sse2;
+#endif
+		return []( const char* d, size_t sz, char de, uint32_t* o ) { return scanSeparators_scalar( d, sz, de, o ); };
+	}();
+	return func( data, size, delim, out );
+}
+//-------------------------------------------------------------------
+/// Scalar version of sumInts()
+int
+sumInts_scalar( const int* data, size_t size )
+{
+	int sum = 0;
+	for( size_t i=0; i<size; i++ )
+		sum += data[i];
+	return sum;
+}
+
+#ifdef ADEPOPRO_HAS_X86_SIMD
+//-------------------------------------------------------------------
+/// SSE2 version of sumInts(): 4 integers added at once
+__attribute__((target("sse2")))
+int
+sumInts_sse2( const int* data, size_t size )
+{
+	__m128i v_sum = _mm_setzero_si128();
+	size_t i = 0;
+	for( ; i+4 <= size; i+=4 )
+		v_sum = _mm_add_epi32( v_sum, _mm_loadu_si128( reinterpret_cast<const __m128i*>( data+i ) ) );
+	v_sum = _mm_add_epi32( v_sum, _mm_shuffle_epi32( v_sum, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	v_sum = _mm_add_epi32( v_sum, _mm_shuffle_epi32( v_sum, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return _mm_cvtsi128_si32( v_sum ) + sumInts_scalar( data+i, size-i );
+}
+//-------------------------------------------------------------------
+/// AVX2 version of sumInts(), 8 integers at once
+__attribute__((target("avx2")))
+int
+sumInts_avx2( const int* data, size_t size )
+{
+	__m256i v_sum = _mm256_setzero_si256();
+	size_t i = 0;
+	for( ; i+8 <= size; i+=8 )
+		v_sum = _mm256_add_epi32( v_sum, _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data+i ) ) );
+	__m128i v_half = _mm_add_epi32( _mm256_castsi256_si128( v_sum ), _mm256_extracti128_si256( v_sum, 1 ) );
+	v_half = _mm_add_epi32( v_half, _mm_shuffle_epi32( v_half, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	v_half = _mm_add_epi32( v_half, _mm_shuffle_epi32( v_half, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return _mm_cvtsi128_si32( v_half ) + sumInts_scalar( data+i, size-i );
+}
+#endif // ADEPOPRO_HAS_X86_SIMD
+
+//-------------------------------------------------------------------
+/// Returns the sum of the \c size integers of \c data, see VolumeColumns
+/**
+The fastest version supported by the CPU is selected on first call, as in scanSeparators().
+*/
+int
+sumInts( const int* data, size_t size )
+{
+	typedef int (*SumIntsFunc)( const int* data, size_t size );
+	static const SumIntsFunc func = []() -> SumIntsFunc    // lambda
+	{
+#ifdef ADEPOPRO_HAS_X86_SIMD
+		__builtin_cpu_init();
+		if( __builtin_cpu_supports( "avx2" ) )
+			return sumInts_avx2;
+		if( __builtin_cpu_supports( "sse2" ) )
+			return sumInts_sse2;
+#endif
+		return sumInts_scalar;
+	}();
+	return func( data, size );
+}
+//-------------------------------------------------------------------
+/// Read-only access to the whole content of a file, memory-mapped when the platform allows it
+class MappedFile
+{
+	public:
+		explicit MappedFile( std::string fn )
+		{
+#ifdef ADEPOPRO_HAS_MMAP
+			int fd = ::open( fn.c_str(), O_RDONLY );
+			if( fd < 0 )
+				throw std::runtime_error( "Error, unable to open file " + fn );
+			struct stat st;
+			if( ::fstat( fd, &st ) != 0 )
+			{
+				::close( fd );
+				throw std::runtime_error( "Error, unable to read size of file " + fn );
+			}
+			_size = static_cast<size_t>( st.st_size );
+			if( _size )
+			{
+				_map = ::mmap( nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0 );
+				if( _map == MAP_FAILED )
+				{
+					::close( fd );
+					throw std::runtime_error( "Error, unable to map file " + fn );
+				}
+				::madvise( _map, _size, MADV_SEQUENTIAL );
+				_data = static_cast<const char*>( _map );
+			}
+			::close( fd );
+#else
+			std::ifstream file( fn, std::ios::binary );
+			if( !file.is_open() )
+				throw std::runtime_error( "Error, unable to open file " + fn );
+			std::ostringstream oss;
+			oss << file.rdbuf();
+			_buffer = oss.str();
+			_data = _buffer.data();
+			_size = _buffer.size();
+#endif
+		}
+		~MappedFile()
+		{
+#ifdef ADEPOPRO_HAS_MMAP
+			if( _size )
+				::munmap( _map, _size );
+#endif
+		}
+		MappedFile( const MappedFile& )              = delete;
+		MappedFile& operator = ( const MappedFile& ) = delete;
+
+		std::string_view view() const
+		{
+			return std::string_view( _data, _size );
+		}
+
+	private:
+		const char* _data = nullptr;
+		size_t      _size = 0;
+#ifdef ADEPOPRO_HAS_MMAP
+		void*       _map  = nullptr;
+#else
+		std::string _buffer;
+#endif
+};
+//-------------------------------------------------------------------
+/// Allocation-free equivalent of std::stoi(): skips leading white space, reads an optional sign and the digits that follow, ignores the rest
+/**
+Throws the same exceptions as std::stoi() if there is no digit or if the value does not fit in an \c int
+*/
+int
+parseInt( std::string_view in )
+{
+	size_t i = 0;
+	while( i < in.size() && std::isspace( static_cast<unsigned char>( in[i] ) ) )
+		i++;
+	bool neg = false;
+	if( i < in.size() && ( in[i] == '-' || in[i] == '+' ) )
+		neg = ( in[i++] == '-' );
+	if( i == in.size() || in[i] < '0' || in[i] > '9' )
+		throw std::invalid_argument( "stoi" );
+
+	long long val = 0;
+	for( ; i < in.size() && in[i] >= '0' && in[i] <= '9'; i++ )
+	{
+		val = val*10 + ( in[i] - '0' );
+		if( val > static_cast<long long>( std::numeric_limits<int>::max() ) + 1 )
+			throw std::out_of_range( "stoi" );
+	}
+	if( neg )
+		val = -val;
+	if( val > std::numeric_limits<int>::max() || val < std::numeric_limits<int>::min() )
+		throw std::out_of_range( "stoi" );
+	return static_cast<int>( val );
+}
+//-------------------------------------------------------------------
 /// Returns week index from "Semaine 8"
 int
-getWeekNum( std::string in )
+getWeekNum( std::string_view in_v )
 {
-	if( in.empty() )
+	if( in_v.empty() )
 		throw std::runtime_error( "Week string is empty in " + std::string(__FUNCTION__) );
-	auto v = split_string( in, ' ' );
-	if( v.size() != 2 )
-		throw std::runtime_error( "Week string must have 2 space separated fields, read this:" + in );
-	return std::stoi( v[1] );
+	auto pos = in_v.find( ' ' );
+	if( pos == std::string_view::npos || in_v.find( ' ', pos+1 ) != std::string_view::npos )
+		throw std::runtime_error( "Week string must have 2 space separated fields, read this:" + std::string(in_v) );
+	return parseInt( in_v.substr( pos+1 ) );
 }
 //-------------------------------------------------------------------
+/// Returns the day from a string holding the french day name and the date, as "Jeudi 22/02/2018"
+/**
+The day name is identified by its first letter (and length for "Mardi"/"Mercredi"), then checked.
+*/
 EN_WeekDay
-getWeekDay( std::string in )
+getWeekDay( std::string_view in_v )
 {
-	if( in.empty() )
+	if( in_v.empty() )
 		throw std::runtime_error( "Week day is empty in " + std::string(__FUNCTION__) );
-	auto v = split_string( in, ' ' );
-	if( v.size() != 2 )
-		throw std::runtime_error( "Date string must have 2 space separated fields, read this:" + in );
-	auto it = g_daymap.find( v[0] );
-	if( it == std::end(g_daymap) )
-		throw std::runtime_error( "Unable to find day: '" + v[0] + "' in allowed days" );
+	auto pos = in_v.find( ' ' );
+	if( pos == std::string_view::npos || in_v.find( ' ', pos+1 ) != std::string_view::npos )
+		throw std::runtime_error( "Date string must have 2 space separated fields, read this:" + std::string(in_v) );
+
+	auto name = in_v.substr( 0, pos );
+	std::string_view expected;
+	EN_WeekDay wd = WD_LUN;
+	switch( name.empty() ? 0 : name.front() )
+	{
+		case 'L': expected = "Lundi";    wd = WD_LUN; break;
+		case 'M':
+			if( name.size() == 5 )
+			{
+				expected = "Mardi";      wd = WD_MAR;
+			}
+			else
+			{
+				expected = "Mercredi";   wd = WD_MER;
+			}
+		break;
+		case 'J': expected = "Jeudi";    wd = WD_JEU; break;
+		case 'V': expected = "Vendredi"; wd = WD_VEN; break;
+		default: break;
+	}
+	if( expected.empty() || name != expected )
+		throw std::runtime_error( "Unable to find day: '" + std::string(name) + "' in allowed days" );
 
-	return it->second;
+	return wd;
+}
+//-------------------------------------------------------------------
+/// Converts a time of day "08h30" into a number of minutes since midnight
+int
+getTimeOfDay( std::string_view in_v )
+{
+	auto pos = in_v.find( 'h' );
+	if( pos == std::string_view::npos || in_v.find( 'h', pos+1 ) != std::string_view::npos )
+		throw std::runtime_error( "Time string expects 'h' as separator and two fields, got this: " + std::string(in_v) );
+	return parseInt( in_v.substr( 0, pos ) ) * 60 + parseInt( in_v.substr( pos+1 ) );
 }
 //-------------------------------------------------------------------
 /// Converts a string "03h00" into a floating point value 3.0
 /// and "01h30" into 1.5
 float
-getDuration( std::string in )
+getDuration( std::string_view in_v )
 {
-	auto v = split_string( in, 'h' );
-	if( v.size() != 2 )
-		throw std::runtime_error( "Time string expects 'h' as separator and two fields, got this: " + in );
+	auto pos = in_v.find( 'h' );
+	if( pos == std::string_view::npos || in_v.find( 'h', pos+1 ) != std::string_view::npos )
+		throw std::runtime_error( "Time string expects 'h' as separator and two fields, got this: " + std::string(in_v) );
 
-	auto h = std::stoi( v[0] );
-	auto mn = std::stoi( v[1] );
+	auto h  = parseInt( in_v.substr( 0, pos ) );
+	auto mn = parseInt( in_v.substr( pos+1 ) );
 	return static_cast<float>( 1.0*h+1.0*mn/60.0 );
 }
 //-------------------------------------------------------------------
+/// Used to write the output files
+/**
+Everything is formatted into a single memory buffer, that is written to the file with a single call
+when close() is called. The file is only opened then, so that all the file system calls can be done
+by an AsyncWriter, and a report that fails while being formatted leaves no file behind.
+
+Large reports can be handed in several parts with split(), all written to the same file.
+If the buffer is destroyed without a successful close(), the parts already written are removed
+when the output is atomic (see Params::atomicWrite).
+
+Numbers are formatted with \c std::to_chars(), giving the same result as an \c std::ostream with default settings.
+*/
+class OutBuffer
+{
+	public:
+/// In-memory buffer, not associated to a file, see str()
+		OutBuffer()
+		{
+		}
+/// Buffer written to file \c fn, or if \c atomic is true to a temporary file renamed into place by close()
+		explicit OutBuffer( std::string fn, bool atomic=false ): _target( std::make_shared<Target>( fn, atomic ) )
+		{
+			_buf.reserve( 1 << 16 );
+		}
+
+/// Writes the content and closes the file, the file is only complete (and renamed for an atomic output) after this
+		void close()
+		{
+			if( !_target )
+				return;
+			write();
+			_target->close();
+			_target.reset();
+		}
+/// Writes the content formatted so far, without closing the file (used by AsyncWriter for the parts given by split())
+		void write()
+		{
+			if( _target )
+				_target->write( _buf );
+			_buf.clear();
+		}
+/// Moves the content formatted so far into a new buffer written to the same file, see AsyncWriter::push()
+		OutBuffer split()
+		{
+			OutBuffer part;
+			part._target = _target;
+			part._isPart = true;
+			std::swap( part._buf, _buf );
+			_buf.reserve( part._buf.capacity() );
+			return part;
+		}
+		bool isPart() const
+		{
+			return _isPart;
+		}
+/// Content not yet written
+		std::string_view str() const
+		{
+			return _buf;
+		}
+		void clear()
+		{
+			_buf.clear();
+		}
+
+		OutBuffer& operator << ( std::string_view str )
+		{
+			_buf.append( str );
+			return *this;
+		}
+		OutBuffer& operator << ( char c )
+		{
+			_buf.push_back( c );
+			return *this;
+		}
+		template<
+			typename T,
+			typename std::enable_if<std::is_integral<T>::value,int>::type = 0
+		>
+		OutBuffer& operator << ( T value )
+		{
+			char tmp[24];
+			auto res = std::to_chars( tmp, tmp+sizeof(tmp), value );
+			_buf.append( tmp, res.ptr );
+			return *this;
+		}
+/// Same as \c printf("%g"), that is what an \c std::ostream does by default
+		OutBuffer& operator << ( double value )
+		{
+			char tmp[32];
+			auto res = std::to_chars( tmp, tmp+sizeof(tmp), value, std::chars_format::general, 6 );
+			_buf.append( tmp, res.ptr );
+			return *this;
+		}
+/// Same as \c printf("%*.*f"), with \c width and \c prec
+		void printFixed( double value, int width, int prec )
+		{
+			char tmp[64];
+			auto res = std::to_chars( tmp, tmp+sizeof(tmp), value, std::chars_format::fixed, prec );
+			pad( ' ', width - static_cast<int>( res.ptr - tmp ) );
+			_buf.append( tmp, res.ptr );
+		}
+/// Adds \c nb times character \c c (nothing if \c nb is negative)
+		void pad( char c, int nb )
+		{
+			if( nb > 0 )
+				_buf.append( static_cast<size_t>(nb), c );
+		}
+
+	private:
+/// The output file, shared by a buffer and its parts, opened by the first write
+		struct Target
+		{
+			Target( std::string fn, bool atomic ): _fn( fn ), _atomic( atomic )
+			{}
+/// Not closed: the file is incomplete, so the temporary file is removed instead of being renamed
+			~Target()
+			{
+				if( !_file.is_open() )
+					return;
+				_file.close();
+				if( _atomic )
+				{
+					std::error_code ec;
+					std::filesystem::remove( tmpName(), ec );
+				}
+			}
+			std::string tmpName() const
+			{
+				return _atomic ? _fn + ".tmp" : _fn;
+			}
+			void write( std::string_view buf )
+			{
+				if( !_file.is_open() )
+				{
+					_file.open( tmpName(), std::ios::binary );
+					if( !_file.is_open() )
+						throw std::runtime_error( "Error, unable to open file " + _fn );
+				}
+				_file.write( buf.data(), buf.size() );
+			}
+			void close()
+			{
+				if( !_file.is_open() )
+					write( std::string_view() );
+				_file.close();
+				if( _file.fail() )
+				{
+					if( _atomic )
+					{
+						std::error_code ec;
+						std::filesystem::remove( tmpName(), ec );
+					}
+					throw std::runtime_error( "Error, unable to write file " + _fn );
+				}
+				if( _atomic )
+					std::filesystem::rename( tmpName(), _fn );
+			}
+
+			std::string   _fn;
+			bool          _atomic;
+			std::ofstream _file;
+		};
+
+		std::shared_ptr<Target> _target;
+		bool                    _isPart = false;
+		std::string             _buf;
+};
+//-------------------------------------------------------------------
+/// Writes OutBuffer objects to their files in a dedicated thread, see writeReports()
+/**
+The reports are formatted concurrently in memory, and this thread does all the file system calls,
+each file being written with one large write (see OutBuffer::close()),
+or with a few ones for the reports that are handed in parts (see OutBuffer::split()).
+The parts of a file are written in the order they are pushed, before the file is closed.
+*/
+class AsyncWriter
+{
+	public:
+		AsyncWriter() : _thread( [this]{ run(); } )
+		{}
+		~AsyncWriter()
+		{
+			stop();
+		}
+		void push( OutBuffer&& file )
+		{
+			{
+				std::lock_guard<std::mutex> lock( _mutex );
+				_queue.push_back( std::move( file ) );
+			}
+			_cond.notify_one();
+		}
+/// Waits until all the files have been written, throws the first error
+		void finish()
+		{
+			stop();
+			if( !_error.empty() )
+				throw std::runtime_error( _error );
+		}
+
+	private:
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock( _mutex );
+				_done = true;
+			}
+			_cond.notify_one();
+			if( _thread.joinable() )
+				_thread.join();
+		}
+		void run()
+		{
+			while( true )
+			{
+				OutBuffer file;
+				{
+					std::unique_lock<std::mutex> lock( _mutex );
+					_cond.wait( lock, [this]{ return _done || !_queue.empty(); } );
+					if( _queue.empty() )
+						return;
+					file = std::move( _queue.front() );
+					_queue.pop_front();
+				}
+				try
+				{
+					if( file.isPart() )
+						file.write();
+					else
+						file.close();
+				}
+				catch( const std::exception& e )
+				{
+					if( _error.empty() )
+						_error = e.what();
+				}
+			}
+		}
+
+		std::mutex              _mutex;
+		std::condition_variable _cond;
+		std::deque<OutBuffer>   _queue;
+		bool                    _done = false;
+		std::string             _error;    ///< first write error, only accessed by the writer thread until it is joined
+		std::thread             _thread;   ///< last, so that it starts once the other members are built
+};
+//-------------------------------------------------------------------
 /// Course type: CM/TD/TP
 enum EN_CourseType {
 	TY_CM,  ///< Lecture (french: "Cours Magistral")
@@ -118,10 +716,14 @@ enum EN_PrintSum { PrintSumYes, PrintSumNo };
 enum EN_PrintEqTd { PrintEqTdYes, PrintEqTdNo };
 
 /// A triplet of course durations (see EN_CourseType)
+/**
+Durations are accumulated as an integer number of minutes, so that sums do not depend on the order
+in which the events are added (see readData_mt()). They are converted to hours when printed.
+*/
 struct Triplet
 {
 private:
-	float _vol[3];
+	int _vol[3];  ///< in minutes
 
 public:
 	explicit Triplet()
@@ -131,7 +733,14 @@ public:
 	Triplet( EN_CourseType ty, float duration )
 	{
 		clear();
-		_vol[ty] = duration;
+		_vol[ty] = static_cast<int>( std::lround( duration*60.f ) );
+	}
+/// Builds a triplet from the number of minutes of each course type
+	Triplet( int cm, int td, int tp )
+	{
+		_vol[TY_CM] = cm;
+		_vol[TY_TD] = td;
+		_vol[TY_TP] = tp;
 	}
 	Triplet& operator += ( const Triplet& t )
 	{
@@ -140,37 +749,58 @@ public:
 		this->_vol[2] += t._vol[2];
 		return *this;
 	}
-	float sum() const
+	Triplet& operator -= ( const Triplet& t )
 	{
-		return _vol[0] + _vol[1] + _vol[2];
+		this->_vol[0] -= t._vol[0];
+		this->_vol[1] -= t._vol[1];
+		this->_vol[2] -= t._vol[2];
+		return *this;
+	}
+	bool operator == ( const Triplet& t ) const
+	{
+		return _vol[0] == t._vol[0] && _vol[1] == t._vol[1] && _vol[2] == t._vol[2];
+	}
+	bool operator != ( const Triplet& t ) const
+	{
+		return !( *this == t );
+	}
+/// Returns the volume of course type \c ty, in minutes
+	int minutes( int ty ) const
+	{
+		return _vol[ty];
+	}
+/// Returns the volume of course type \c ty, in hours
+	double hours( int ty ) const
+	{
+		return _vol[ty] / 60.0;
+	}
+	double sum() const
+	{
+		return ( int64_t(_vol[0]) + _vol[1] + _vol[2] ) / 60.0;
 	}
-	float sumEqTD() const
+/// Returns the volume in "TD-equivalent" hours: CM count 3/2, TP count 2/3
+/**
+Computed in sixths of minutes, so the only rounding is the final conversion to hours.
+*/
+	double sumEqTD() const
 	{
-		return _vol[0]*3/2 + _vol[1] + _vol[2]*2/3;
+		return ( int64_t(_vol[0])*9 + int64_t(_vol[1])*6 + int64_t(_vol[2])*4 ) / 360.0;
 	}
-	friend std::ostream& operator << ( std::ostream& f, const Triplet& tri )
+	friend OutBuffer& operator << ( OutBuffer& f, const Triplet& tri )
 	{
-		f << tri._vol[0] << g_ocs << tri._vol[1] << g_ocs << tri._vol[2] << g_ocs << tri.sum();
+		f << tri.hours(0) << g_ocs << tri.hours(1) << g_ocs << tri.hours(2) << g_ocs << tri.sum();
 		return f;
 	}
-	void printAsText( std::ostream& f ) const
+	void printAsText( OutBuffer& f ) const
 	{
-		f << "CM: " << _vol[0] << " h. - TD: " << _vol[1] << " h. - TP: " << _vol[2] << " h., total: "
+		f << "CM: " << hours(0) << " h. - TD: " << hours(1) << " h. - TP: " << hours(2) << " h., total: "
 			<< sum() << " h., heqTD: " << sumEqTD() << " h.";
 	}
-	void printTabulated( std::ostream& f, int tab_size, EN_PrintSum psum=PrintSumNo, EN_PrintEqTd peqtd=PrintEqTdNo ) const
+	void printTabulated( OutBuffer& f, int tab_size, EN_PrintSum psum=PrintSumNo, EN_PrintEqTd peqtd=PrintEqTdNo ) const
 	{
-#if 0
-		f << std::setw(tab_size) << _vol[0]
-			<< std::setw(tab_size) << _vol[1]
-			<< std::setw(tab_size) << _vol[2];
-#else
-		std::ostringstream oss;
-		oss << "%" << tab_size << ".1f";
-		f <<   boost::format( oss.str() ) % _vol[0]
-			<< boost::format( oss.str() ) % _vol[1]
-			<< boost::format( oss.str() ) % _vol[2];
-#endif // 0
+		f.printFixed( hours(0), tab_size, 1 );
+		f.printFixed( hours(1), tab_size, 1 );
+		f.printFixed( hours(2), tab_size, 1 );
 		if( psum == PrintSumYes )
 		{
 			f << "  total = " << sum() << " h.";
@@ -182,10 +812,64 @@ public:
 	}
 	void clear()
 	{
-		_vol[0] = _vol[1] = _vol[2] = 0.0f;
+		_vol[0] = _vol[1] = _vol[2] = 0;
 	}
 };
 
+//-------------------------------------------------------------------
+/// An array of Triplet, stored as a structure of arrays: one array of minutes per course type
+/**
+Sums over a range of elements are done type by type on contiguous integers, with sumInts().
+*/
+class VolumeColumns
+{
+	public:
+		size_t size() const
+		{
+			return _minutes[0].size();
+		}
+		void reserve( size_t nb )
+		{
+			for( auto& col: _minutes )
+				col.reserve( nb );
+		}
+		void push_back( const Triplet& tri )
+		{
+			for( int ty=0; ty<3; ty++ )
+				_minutes[ty].push_back( tri.minutes( ty ) );
+		}
+		Triplet operator [] ( size_t i ) const
+		{
+			return Triplet( _minutes[0][i], _minutes[1][i], _minutes[2][i] );
+		}
+		void set( size_t i, const Triplet& tri )
+		{
+			for( int ty=0; ty<3; ty++ )
+				_minutes[ty][i] = tri.minutes( ty );
+		}
+		void add( size_t i, const Triplet& tri )
+		{
+			for( int ty=0; ty<3; ty++ )
+				_minutes[ty][i] += tri.minutes( ty );
+		}
+/// Returns the sum of elements \c first (included) to \c last (excluded)
+		Triplet sum( size_t first, size_t last ) const
+		{
+			assert( first <= last && last <= size() );
+			return Triplet(
+				sumInts( _minutes[0].data()+first, last-first ),
+				sumInts( _minutes[1].data()+first, last-first ),
+				sumInts( _minutes[2].data()+first, last-first )
+			);
+		}
+		Triplet sum() const
+		{
+			return sum( 0, size() );
+		}
+
+	private:
+		std::array<std::vector<int>,3> _minutes;   ///< index: EN_CourseType
+};
 //-------------------------------------------------------------------
 /// Holds the data associated to an instructor or a course module
 struct ResourceData
@@ -198,29 +882,30 @@ struct ResourceData
 /// If module data, this will hold the nb of instructors on this module
 	size_t      _nbOtherResources = 0;
 
-	void incrementDays( size_t n )
-	{
-		_nbDays += n;
-	}
-	friend std::ostream& operator << ( std::ostream& f, const ResourceData& ins )
+	friend OutBuffer& operator << ( OutBuffer& f, const ResourceData& ins )
 	{
 		f << ins._nbDays << g_ocs << ins._nbWeeks << g_ocs << ins._volume << g_ocs << ins._nbOtherResources;
 		return f;
 	}
 };
 //-------------------------------------------------------------------
-std::ofstream
-openFile( std::string fn, std::string text, std::string input_fn )
+OutBuffer
+openFile( std::string fn, std::string text, std::string input_fn, bool atomic=false )
 {
-	std::ofstream file( fn );
-	if( !file.is_open() )
-		throw std::runtime_error( "Error, unable to open file " + fn );
+	OutBuffer file( fn, atomic );
 
-	std::cout << " - génération du fichier " << fn << '\n';
+	std::cout << " - génération du fichier " + fn + '\n';       // single call, as the reports are written concurrently
 	file << "# generated by: AdePoPro, see https://github.com/skramm/adepopro"
 		<< "\n# generated on: ";
 	auto time = std::time(nullptr);
-	file << std::put_time(std::localtime(&time), "%F %T%z")
+	std::tm tm;
+#ifdef _WIN32
+	localtime_s( &tm, &time );
+#else
+	localtime_r( &time, &tm );     // thread-safe version, see processBatch()
+#endif
+	char date[64];
+	file << std::string_view( date, std::strftime( date, sizeof(date), "%F %T%z", &tm ) )
 		<< "\n# input data file: " << input_fn << '\n';
 
 	file << text << '\n';
@@ -228,99 +913,625 @@ openFile( std::string fn, std::string text, std::string input_fn )
 	return file;
 }
 
-/// Used for counting on which days and week a resource is used
-typedef
-	std::map<
-		std::string,  // name
-		std::map<
-			size_t,   // week number
-			std::set<EN_WeekDay>
-		>
-	>
-	ResourceDays;
-
-typedef std::map<std::string,Triplet> TripletMap;
-
-/// Used to store the volume associated to resources
-typedef std::map<std::string,TripletMap> ResourceVolumeMap;
-
-/// Used to stored the data associated to a key (which can be an instructor or a course module)
-typedef	std::map<std::string,ResourceData> ResourceDataMap;
+//-------------------------------------------------------------------
+/// 64 bits hash of a byte buffer
+/**
+Not a cryptographic hash, only used to detect that a file has changed and for the hash tables (see FlatIdTable).
+Processes 8 bytes at a time, so it runs much faster than the parsing.
+*/
+uint64_t
+hashBytes( std::string_view buf, uint64_t h = 0x9E3779B97F4A7C15ull )
+{
+	const uint64_t mul = 0xFF51AFD7ED558CCDull;
+	size_t i = 0;
+	for( ; i+8 <= buf.size(); i+=8 )
+	{
+		uint64_t w;
+		std::memcpy( &w, buf.data()+i, 8 );
+		h = ( h ^ w ) * mul;
+		h ^= h >> 29;
+	}
+	for( ; i<buf.size(); i++ )
+	{
+		h = ( h ^ static_cast<unsigned char>( buf[i] ) ) * mul;
+		h ^= h >> 29;
+	}
+	h ^= buf.size();
+	h *= mul;
+	return h ^ ( h >> 32 );
+}
+//-------------------------------------------------------------------
+/// 64 bits hash of an integer key (finalizer of MurmurHash3), see FlatIdTable
+inline uint64_t
+hashKey( uint64_t k )
+{
+	k ^= k >> 33;
+	k *= 0xFF51AFD7ED558CCDull;
+	k ^= k >> 33;
+	k *= 0xC4CEB9FE1A85EC53ull;
+	return k ^ ( k >> 33 );
+}
+//-------------------------------------------------------------------
+/// Open-addressing hash table giving the ID associated to a key, the keys themselves being held by the owner
+/**
+Each slot holds the precomputed hash of its key and the ID, in one flat array.
+A lookup only compares keys (through the function given by the owner) when the hashes are equal,
+and growing the table does not need the keys.
+Linear probing, the table is kept at most half full.
+*/
+class FlatIdTable
+{
+	public:
+		static constexpr uint32_t NotFound = std::numeric_limits<uint32_t>::max();
+
+/// Returns the ID of the key whose hash is \c hash and for which \c isKey(id) is true, or NotFound
+		template<typename FUNC>
+		uint32_t find( uint64_t hash, FUNC&& isKey ) const
+		{
+			if( _slots.empty() )
+				return NotFound;
+			for( size_t i=hash & _mask; ; i=(i+1) & _mask )
+			{
+				const auto& slot = _slots[i];
+				if( slot._id == NotFound )
+					return NotFound;
+				if( slot._hash == hash && isKey( slot._id ) )
+					return slot._id;
+			}
+		}
+/// Adds \c id, with key hash \c hash, the key must not be already there
+		void insert( uint64_t hash, uint32_t id )
+		{
+			if( 2*( _size+1 ) > _slots.size() )
+				grow();
+			place( hash, id );
+			_size++;
+		}
+		void clear()
+		{
+			_slots.clear();
+			_mask = 0;
+			_size = 0;
+		}
+
+	private:
+		struct Slot
+		{
+			uint64_t _hash = 0;
+			uint32_t _id   = NotFound;
+		};
+		void place( uint64_t hash, uint32_t id )
+		{
+			size_t i = hash & _mask;
+			while( _slots[i]._id != NotFound )
+				i = (i+1) & _mask;
+			_slots[i]._hash = hash;
+			_slots[i]._id   = id;
+		}
+		void grow()
+		{
+			std::vector<Slot> old( std::max( _slots.size()*2, size_t(16) ) );
+			old.swap( _slots );
+			_mask = _slots.size()-1;
+			for( const auto& slot: old )
+				if( slot._id != NotFound )
+					place( slot._hash, slot._id );
+		}
+
+		std::vector<Slot> _slots;
+		size_t            _mask = 0;
+		size_t            _size = 0;
+};
+
+/// Associates a dense integer ID (0,1,2,...) to each distinct string, in order of first occurrence
+/**
+Used to handle instructors and modules as integers while reading the input file,
+names are only needed again when the output files are written.
+
+The characters of the names are allocated in a monotonic arena owned by the object, so interning a new string
+costs no call to the global allocator and all the memory is released at once.
+The arena is held by a pointer, so that moving the object keeps it in place.
+IDs are found with a FlatIdTable, the names are only sorted when needed for output, see sortedIds().
+*/
+class StringInterner
+{
+	public:
+		StringInterner() : _arena( new std::pmr::monotonic_buffer_resource( 16*1024 ) )
+		{}
+		StringInterner( StringInterner&& )              = default;
+		StringInterner& operator = ( StringInterner&& ) = default;
+		StringInterner( const StringInterner& other ) : StringInterner()
+		{
+			*this = other;
+		}
+		StringInterner& operator = ( const StringInterner& other )
+		{
+			if( this != &other )
+			{
+				_arena.reset( new std::pmr::monotonic_buffer_resource( 16*1024 ) );
+				_index.clear();
+				_names.clear();
+				_names.reserve( other._names.size() );
+				for( auto name: other._names )
+					intern( name );
+			}
+			return *this;
+		}
+
+/// Returns the ID of \c str, adds it if it is not already there
+		uint32_t intern( std::string_view str )
+		{
+			auto hash = hashBytes( str );
+			auto id   = _index.find( hash, [this,str]( uint32_t i ){ return _names[i] == str; } );
+			if( id != FlatIdTable::NotFound )
+				return id;
+			id = static_cast<uint32_t>( _names.size() );
+			auto* buf = static_cast<char*>( _arena->allocate( std::max( str.size(), size_t(1) ), 1 ) );
+			std::memcpy( buf, str.data(), str.size() );
+			_names.emplace_back( buf, str.size() );
+			_index.insert( hash, id );
+			return id;
+		}
+/// Stores in \c id the ID of \c str and returns true, or returns false if \c str is unknown
+		bool find( std::string_view str, uint32_t& id ) const
+		{
+			auto found = _index.find( hashBytes( str ), [this,str]( uint32_t i ){ return _names[i] == str; } );
+			if( found == FlatIdTable::NotFound )
+				return false;
+			id = found;
+			return true;
+		}
+		std::string_view name( uint32_t id ) const
+		{
+			return _names[id];
+		}
+		size_t size() const
+		{
+			return _names.size();
+		}
+/// Returns the IDs, sorted by name
+		std::vector<uint32_t> sortedIds() const
+		{
+			std::vector<uint32_t> ids( _names.size() );
+			for( size_t i=0; i<ids.size(); i++ )
+				ids[i] = static_cast<uint32_t>(i);
+			std::sort(
+				std::begin(ids),
+				std::end(ids),
+				[this]           // lambda
+				( uint32_t id1, uint32_t id2 )
+				{
+					return _names[id1] < _names[id2];
+				}
+			);
+			return ids;
+		}
+
+	private:
+		std::unique_ptr<std::pmr::monotonic_buffer_resource>    _arena;   ///< holds the characters of the names
+		std::vector<std::string_view>                           _names;   ///< views on the arena
+		FlatIdTable                                             _index;
+};
+
+/// Number of bits set in \c v
+inline size_t
+popCount( uint64_t v )
+{
+#ifdef __GNUC__
+	return static_cast<size_t>( __builtin_popcountll( v ) );
+#else
+	size_t nb = 0;
+	for( ; v; v &= v-1 )
+		nb++;
+	return nb;
+#endif
+}
+//-------------------------------------------------------------------
+/// Returns the mask of weeks \c first to \c last (included), see Presence
+uint64_t
+weekMask( size_t first, size_t last )
+{
+	assert( first <= last && last < 64 );
+	uint64_t upTo = ( last == 63 ? ~uint64_t(0) : ( uint64_t(1) << (last+1) ) - 1 );
+	return upTo & ~( ( uint64_t(1) << first ) - 1 );
+}
+//-------------------------------------------------------------------
+/// Days and weeks on which a resource is used, as a bit set
+/**
+Holds one 64 bits word per week day, bit \c n of a word being set if the resource is used on that day of week \c n.
+Thus weeks must be numbered from 0 to 63 (ADE uses 1 to 53).
+*/
+struct Presence
+{
+	static constexpr size_t NbWeeks = 64;
+
+	std::array<uint64_t,5> _days = {};   ///< index: EN_WeekDay
+
+	void set( size_t week, EN_WeekDay wd )
+	{
+		assert( week < NbWeeks );
+		_days[wd] |= uint64_t(1) << week;
+	}
+	Presence& operator |= ( const Presence& p )
+	{
+		for( size_t i=0; i<_days.size(); i++ )
+			_days[i] |= p._days[i];
+		return *this;
+	}
+	bool operator == ( const Presence& p ) const
+	{
+		return _days == p._days;
+	}
+/// Keeps only the weeks set in \c weeks, see weekMask()
+	void mask( uint64_t weeks )
+	{
+		for( auto& d: _days )
+			d &= weeks;
+	}
+/// Returns the mask of the weeks where the resource is used at least once
+	uint64_t weeks() const
+	{
+		uint64_t mask = 0;
+		for( auto d: _days )
+			mask |= d;
+		return mask;
+	}
+	size_t nbDays() const
+	{
+		size_t nb = 0;
+		for( auto d: _days )
+			nb += popCount( d );
+		return nb;
+	}
+	size_t nbWeeks() const
+	{
+		return popCount( weeks() );
+	}
+};
+
+/// Used for counting on which days and week a resource is used, indexed by resource ID
+typedef std::vector<Presence> ResourceDays;
+
+//-------------------------------------------------------------------
+/// Holds the volume of each (module,instructor) pair, while reading the input data
+/**
+Volumes are stored in a flat array, in order of first occurrence of the pair,
+a hash table (see FlatIdTable) gives the index of a pair from the two IDs.
+
+The volume of each week is only kept if keepWeekly() has been called, as it takes Presence::NbWeeks
+triplets per pair. It is needed to restrict the volumes to some weeks, or to build a WeekMatrix.
+
+When no report needs the modules themselves (see Data::select()), keyByName() makes the pairs identified by the instructor ID
+and the name of the module, so that the modules do not have to be interned: a single lookup is done for each event.
+*/
+class PairVolumes
+{
+	public:
+/// Value of module() when the pairs are identified by the module name, see keyByName()
+		static constexpr uint32_t NoModule = std::numeric_limits<uint32_t>::max();
+
+/// Keeps the volume of each week, must be called before adding volumes
+		void keepWeekly()
+		{
+			assert( size() == 0 );
+			_keepWeekly = true;
+		}
+		bool hasWeekly() const
+		{
+			return _keepWeekly;
+		}
+/// Identifies the pairs by the module name instead of the module ID, must be called before adding volumes
+		void keyByName()
+		{
+			assert( size() == 0 );
+			_byName = true;
+		}
+		bool byName() const
+		{
+			return _byName;
+		}
+/// Adds volume \c tri to the pair \c i (see index()), in week \c week
+		void add( size_t i, size_t week, const Triplet& tri )
+		{
+			_volumes.add( i, tri );
+			if( _keepWeekly )
+				_weekly[ i*Presence::NbWeeks + week ] += tri;
+			_weeks[i] |= uint64_t(1) << week;
+		}
+/// Adds to the pair \c i the per-week volumes \c weekly (Presence::NbWeeks values) of the weeks set in \c weeks
+		void addWeekly( size_t i, uint64_t weeks, const Triplet* weekly )
+		{
+			for( size_t w=0; w<Presence::NbWeeks; w++ )
+				if( weeks & ( uint64_t(1) << w ) )
+				{
+					_volumes.add( i, weekly[w] );
+					if( _keepWeekly )
+						_weekly[ i*Presence::NbWeeks + w ] += weekly[w];
+				}
+			_weeks[i] |= weeks;
+		}
+/// Adds to the pair \c i the volume \c tri, spread over the weeks set in \c weeks (only if the weekly volumes are not kept)
+		void addTotal( size_t i, uint64_t weeks, const Triplet& tri )
+		{
+			assert( !_keepWeekly );
+			_volumes.add( i, tri );
+			_weeks[i] |= weeks;
+		}
+/// Adds the pair \c j of \c other to the pair \c i, see Data::merge()
+		void addPair( size_t i, const PairVolumes& other, size_t j )
+		{
+			if( other.hasWeekly() )
+				addWeekly( i, other.weeks(j), other.weekly(j) );
+			else
+				addTotal( i, other.weeks(j), other.volume(j) );
+		}
+/// Returns the index of the pair (\c module, \c instr), adds it if needed
+		size_t index( uint32_t module, uint32_t instr )
+		{
+			assert( !_byName );
+			auto hash = hashKey( ( static_cast<uint64_t>(module) << 32 ) | instr );
+			auto i    = _index.find( hash, [&]( uint32_t j ){ return _pairs[j].first == module && _pairs[j].second == instr; } );
+			if( i != FlatIdTable::NotFound )
+				return i;
+			_index.insert( hash, static_cast<uint32_t>( size() ) );
+			return newPair( module, instr );
+		}
+/// Returns the index of the pair (module named \c module, \c instr), adds it if needed, see keyByName()
+		size_t index( std::string_view module, uint32_t instr )
+		{
+			assert( _byName );
+			auto hash = hashBytes( module, hashKey( instr ) );
+			auto i    = _index.find( hash, [&]( uint32_t j ){ return _pairs[j].second == instr && moduleName(j) == module; } );
+			if( i != FlatIdTable::NotFound )
+				return i;
+			_index.insert( hash, static_cast<uint32_t>( size() ) );
+			_nameChars.append( module );
+			_nameEnd.push_back( _nameChars.size() );
+			return newPair( NoModule, instr );
+		}
+		size_t size() const
+		{
+			return _volumes.size();
+		}
+		uint32_t module( size_t i ) const
+		{
+			return _pairs[i].first;
+		}
+/// Name of the module of pair \c i, only if byName()
+		std::string_view moduleName( size_t i ) const
+		{
+			auto start = ( i ? _nameEnd[i-1] : 0 );
+			return std::string_view( _nameChars ).substr( start, _nameEnd[i]-start );
+		}
+		uint32_t instructor( size_t i ) const
+		{
+			return _pairs[i].second;
+		}
+		Triplet volume( size_t i ) const
+		{
+			return _volumes[i];
+		}
+/// Returns the mask of the weeks where the pair has some events
+		uint64_t weeks( size_t i ) const
+		{
+			return _weeks[i];
+		}
+/// Returns the volumes of each week (Presence::NbWeeks values), only if hasWeekly()
+		const Triplet* weekly( size_t i ) const
+		{
+			assert( _keepWeekly );
+			return &_weekly[ i*Presence::NbWeeks ];
+		}
+
+/// Keeps only the volumes of weeks \c first to \c last (included), computed from the per-week volumes
+/**
+The pairs that have no events in these weeks are kept, with an empty mask of weeks.
+The weeks outside the range are removed from the masks, so a second call can only restrict the range further.
+*/
+		void restrictToWeeks( size_t first, size_t last )
+		{
+			assert( _keepWeekly );
+			auto mask = weekMask( first, last );
+			for( size_t i=0; i<size(); i++ )
+			{
+				_weeks[i] &= mask;
+				const auto* weekly = &_weekly[ i*Presence::NbWeeks ];
+				Triplet vol;
+				for( auto weeks = _weeks[i]; weeks; weeks &= weeks-1 )
+					vol += weekly[ popCount( ( weeks & (~weeks+1) ) - 1 ) ];
+				_volumes.set( i, vol );
+			}
+		}
+
+	private:
+		size_t newPair( uint32_t module, uint32_t instr )
+		{
+			_pairs.emplace_back( module, instr );
+			_volumes.push_back( Triplet() );
+			_weeks.push_back( 0 );
+			if( _keepWeekly )
+				_weekly.resize( _weekly.size() + Presence::NbWeeks );
+			return _volumes.size()-1;
+		}
+
+		FlatIdTable                                 _index;   ///< pair index from the two IDs, or from the instructor ID and the module name if byName()
+		std::string                                 _nameChars; ///< module names of the pairs one after the other, if byName()
+		std::vector<size_t>                         _nameEnd;   ///< end of the name of each pair in _nameChars
+		std::vector<std::pair<uint32_t,uint32_t>>   _pairs;   ///< (module,instructor)
+		VolumeColumns                               _volumes; ///< total volume of each pair
+		std::vector<uint64_t>                       _weeks;   ///< weeks of each pair, see Presence
+		std::vector<Triplet>                        _weekly;  ///< volume of each pair and each week, index: pair*NbWeeks+week, only if keepWeekly()
+		bool                                        _keepWeekly = false;
+		bool                                        _byName     = false;
+};
+
+//-------------------------------------------------------------------
+/// Used to store the volume associated to resources, as a Compressed Sparse Row matrix
+/**
+Rows and entries of each row are sorted by name, so the matrix can directly be printed.
+Built from a PairVolumes object, see buildVolumeMatrix()
+*/
+struct ResourceVolumeMap
+{
+	std::vector<uint32_t> _rowIds;    ///< resource ID of each row
+	std::vector<size_t>   _rowStart;  ///< index of the first entry of each row, has one more element than the number of rows
+	std::vector<uint32_t> _colIds;    ///< resource ID of each entry
+	VolumeColumns         _volumes;   ///< volume of each entry
+
+	size_t nbRows() const
+	{
+		return _rowIds.size();
+	}
+};
+
+/// Used to stored the data associated to a key (which can be an instructor or a course module), indexed by resource ID
+typedef	std::vector<ResourceData> ResourceDataMap;
+
+//-------------------------------------------------------------------
+/// Builds the sorted matrix of volumes, either by module (\c byModule true) or by instructor
+ResourceVolumeMap
+buildVolumeMatrix( const PairVolumes& pv, bool byModule, const StringInterner& rowNames, const StringInterner& colNames )
+{
+	auto rowOrder = rowNames.sortedIds();
+	auto colOrder = colNames.sortedIds();
+	std::vector<uint32_t> rowRank( rowOrder.size() ), colRank( colOrder.size() );
+	for( size_t i=0; i<rowOrder.size(); i++ )
+		rowRank[rowOrder[i]] = static_cast<uint32_t>(i);
+	for( size_t i=0; i<colOrder.size(); i++ )
+		colRank[colOrder[i]] = static_cast<uint32_t>(i);
+
+	auto rowOf = [&]( size_t i ) { return byModule ? pv.module(i) : pv.instructor(i); };
+	auto colOf = [&]( size_t i ) { return byModule ? pv.instructor(i) : pv.module(i); };
 
+	std::vector<uint64_t> entries( pv.size() );          // (row rank, col rank) of each pair
+	for( size_t i=0; i<pv.size(); i++ )
+		entries[i] = ( static_cast<uint64_t>( rowRank[rowOf(i)] ) << 32 ) | colRank[colOf(i)];
+	std::vector<uint32_t> idx( pv.size() );
+	for( size_t i=0; i<idx.size(); i++ )
+		idx[i] = static_cast<uint32_t>(i);
+	std::sort( std::begin(idx), std::end(idx), [&]( uint32_t i1, uint32_t i2 ){ return entries[i1] < entries[i2]; } );
+
+	ResourceVolumeMap rvm;
+	rvm._colIds.reserve( idx.size() );
+	rvm._volumes.reserve( idx.size() );
+	for( auto i: idx )
+	{
+		if( pv.weeks(i) == 0 )          // no event in the selected weeks, see Data::restrictToWeeks()
+			continue;
+		if( rvm._rowIds.empty() || rvm._rowIds.back() != rowOf(i) )
+		{
+			rvm._rowIds.push_back( rowOf(i) );
+			rvm._rowStart.push_back( rvm._colIds.size() );
+		}
+		rvm._colIds.push_back( colOf(i) );
+		rvm._volumes.push_back( pv.volume(i) );
+	}
+	rvm._rowStart.push_back( rvm._colIds.size() );
+	return rvm;
+}
 //-------------------------------------------------------------------
+/// Computes the volume and number of other resources of each resource that has been flagged in \c dirty
 void
 process(
-	const ResourceVolumeMap& ressVol,  ///< input data
-	ResourceDataMap&         data      ///< output data
+	const PairVolumes&       pv,        ///< input data
+	bool                     byModule,  ///< true if \c data is about modules, false if about instructors
+	const std::vector<char>& dirty,     ///< index: resource ID
+	ResourceDataMap&         data       ///< output data
 )
 {
-		for( const auto& elem: ressVol )
+	for( size_t id=0; id<data.size(); id++ )
+		if( dirty[id] )
 		{
-			Triplet tot;
-			size_t nb = 0;
-			for( const auto& elem2: elem.second )
-			{
-				tot += elem2.second;
-				nb++;
-			}
+			data[id]._volume.clear();
+			data[id]._nbOtherResources = 0;
+		}
+	for( size_t i=0; i<pv.size(); i++ )
+	{
+		auto id = byModule ? pv.module(i) : pv.instructor(i);
+		if( dirty[id] && pv.weeks(i) )
+		{
+			data[id]._volume += pv.volume(i);
+			data[id]._nbOtherResources++;
+		}
+	}
+}
+//-------------------------------------------------------------------
+/// Dense matrix of the volume of each resource in each week, see buildWeekMatrix()
+struct WeekMatrix
+{
+	std::vector<Triplet> _volumes;     ///< row-major, index: resource ID * Presence::NbWeeks + week
+	uint64_t             _weeks = 0;   ///< weeks that have some volume, see Presence
+
+	const Triplet* row( size_t id ) const
+	{
+		return &_volumes[ id*Presence::NbWeeks ];
+	}
+};
 
-			data[elem.first]._volume = tot;
-			data[elem.first]._nbOtherResources = nb;
+/// Sums the per-week volumes of the pairs of \c pv by instructor, or by module if \c byModule is true
+/**
+Uses the per-week volumes stored in \c pv while reading, so the input data is not parsed again.
+Only the weeks of each pair that are kept (see Data::restrictToWeeks()) are added.
+*/
+WeekMatrix
+buildWeekMatrix( const PairVolumes& pv, bool byModule, size_t nbRows )
+{
+	WeekMatrix wm;
+	wm._volumes.resize( nbRows * Presence::NbWeeks );
+	for( size_t i=0; i<pv.size(); i++ )
+	{
+		auto id     = byModule ? pv.module(i) : pv.instructor(i);
+		auto* row   = &wm._volumes[ id*Presence::NbWeeks ];
+		auto weekly = pv.weekly(i);
+		for( auto weeks = pv.weeks(i); weeks; weeks &= weeks-1 )
+		{
+			auto w = popCount( ( weeks & (~weeks+1) ) - 1 );
+			row[w] += weekly[w];
 		}
+		wm._weeks |= pv.weeks(i);
+	}
+	return wm;
 }
 //-------------------------------------------------------------------
+/// Merges the days/weeks of \c src into \c dst, \c idMap gives the ID in \c dst of each ID of \c src
 void
-printChars( std::ostream& f, char c, int nb )
+mergeDays( ResourceDays& dst, const ResourceDays& src, const std::vector<uint32_t>& idMap )
 {
-	for( int i=0; i<nb; i++ )
-		f << c;
+	for( size_t id=0; id<src.size(); id++ )
+		dst[idMap[id]] |= src[id];
 }
 //-------------------------------------------------------------------
 void
-printString( std::ofstream& f, std::string str, size_t size_max )
+printString( OutBuffer& f, std::string_view str, size_t size_max )
 {
 	assert( size_max >= str.size() );
 	f << str;
-	printChars( f, ' ', size_max-str.size() );
+	f.pad( ' ', size_max-str.size() );
 }
 //-------------------------------------------------------------------
+/// Prints the entries of row \c row of \c rvm, whose names are in \c colNames
 Triplet
-printTripletMap( std::ofstream& file, const TripletMap& tmap, size_t max_first )
+printTripletMap( OutBuffer& file, const ResourceVolumeMap& rvm, size_t row, const StringInterner& colNames, size_t max_first )
 {
 	int tab_size = 6;
-	Triplet sum;
-	printChars( file, ' ', 8+max_first );
+	file.pad( ' ', 8+max_first );
 	file << "CM    TD    TP\n";
-	for( const auto& elem: tmap )
+	for( size_t i=rvm._rowStart[row]; i<rvm._rowStart[row+1]; i++ )
 	{
 		file << "  - ";
-		printString( file, elem.first, max_first );
+		printString( file, colNames.name( rvm._colIds[i] ), max_first );
 		file << ": ";
-		elem.second.printTabulated( file, tab_size );
+		rvm._volumes[i].printTabulated( file, tab_size );
 		file << '\n';
-		sum += elem.second;
 	}
+	auto sum = rvm._volumes.sum( rvm._rowStart[row], rvm._rowStart[row+1] );
 	file << "- TOTAL: ";
-	printChars( file, ' ', max_first-3 );
+	file.pad( ' ', max_first-3 );
 	sum.printTabulated( file, tab_size, PrintSumYes, PrintEqTdYes );
 	file << "\n\n";
 	return sum;
 }
 //-------------------------------------------------------------------
-/// Distributes the elements in \c rvm in several maps of same type, based on the value of character \c groupKey
-std::map<char,ResourceVolumeMap>
-distributeMap( const ResourceVolumeMap& rvm, int groupKey )
-{
-	std::map<char,ResourceVolumeMap> out;
-	for( const auto& elem: rvm )
-	{
-		auto index_char = elem.first.substr( groupKey, 1 ).at(0);
-		auto& current = out[index_char];
-		current[elem.first] = elem.second;
-	}
-	return out;
-}
-//-------------------------------------------------------------------
 /// Analyse pair-map string, and convert into a real std::map
 /**
 Used To assign a string to a key found in the module name.
@@ -357,8 +1568,102 @@ printKeyPairs( std::ostream& f, const std::map<char,std::string>& groupKey_pairs
 	}
 }
 //-------------------------------------------------------------------
+/// The output files that can be selected with option "--reports", as bit flags, see Params::reports
+enum EN_Report : unsigned {
+	RP_E   = 1,   ///< instructors csv file
+	RP_M   = 2,   ///< modules csv file
+	RP_ME  = 4,   ///< modules/instructors report
+	RP_EM  = 8,   ///< instructors/modules report
+	RP_EW  = 16,  ///< instructors x weeks csv file, only if requested
+	RP_MW  = 32,  ///< modules x weeks csv file, only if requested
+	RP_All = RP_E | RP_M | RP_ME | RP_EM   ///< default selection
+};
+
+//-------------------------------------------------------------------
+/// A level of grouping of the modules in the "ME" report, based on one character of the module code, see writeReport_MI()
+struct GroupLevel
+{
+	bool                       enabled;
+	int                        pos;     ///< char position in the module code
+	std::string                name;
+	std::map<char,std::string> pairs;   ///< label to print for each character value, see extractPairs()
+};
+
+//-------------------------------------------------------------------
+/// Tree of the groups of the rows of a ResourceVolumeMap, see buildGroupTree()
+/**
+Node 0 is the root, the children of a node of depth \c d are the groups of GroupLevel \c d.
+Nodes only hold row indexes, the matrix itself is not copied.
+*/
+struct GroupTree
+{
+	struct Node
+	{
+		char                  _key = 0;   ///< character of the row names for this group
+		Triplet               _volume;    ///< total volume of the rows of the group
+		std::vector<uint32_t> _children;  ///< indexes in _nodes, sorted by key
+		std::vector<size_t>   _rows;      ///< rows of the group, only for leaves
+	};
+	std::vector<Node> _nodes;
+};
+
+/// Builds in one pass over the rows of \c rvm the tree of groups of the first \c nbLevels levels of \c levels
+GroupTree
+buildGroupTree( const ResourceVolumeMap& rvm, const StringInterner& rowNames, const std::vector<GroupLevel>& levels, size_t nbLevels )
+{
+	GroupTree tree;
+	auto& nodes = tree._nodes;
+	nodes.emplace_back();
+	for( size_t row=0; row<rvm.nbRows(); row++ )
+	{
+		auto name = rowNames.name( rvm._rowIds[row] );
+		auto vol = rvm._volumes.sum( rvm._rowStart[row], rvm._rowStart[row+1] );
+
+		uint32_t node = 0;
+		nodes[node]._volume += vol;
+		for( size_t lev=0; lev<nbLevels; lev++ )
+		{
+			auto pos = levels[lev].pos;
+			if( pos < 0 || static_cast<size_t>(pos) >= name.size() )
+				throw std::runtime_error( "Error, module code '" + std::string( name ) + "' has no character at grouping position " + std::to_string( pos ) );
+			auto key = name[pos];
+			auto it = std::find_if(
+				std::begin( nodes[node]._children ),
+				std::end( nodes[node]._children ),
+				[&nodes,key]( uint32_t child ){ return nodes[child]._key == key; }
+			);
+			if( it != std::end( nodes[node]._children ) )
+				node = *it;
+			else
+			{
+				auto child = static_cast<uint32_t>( nodes.size() );
+				nodes[node]._children.push_back( child );
+				nodes.emplace_back();
+				nodes.back()._key = key;
+				node = child;
+			}
+			nodes[node]._volume += vol;
+		}
+		nodes[node]._rows.push_back( row );
+	}
+	for( auto& nd: nodes )
+		std::sort(
+			std::begin( nd._children ),
+			std::end( nd._children ),
+			[&nodes]( uint32_t c1, uint32_t c2 ){ return nodes[c1]._key < nodes[c2]._key; }
+		);
+	return tree;
+}
+//-------------------------------------------------------------------
 /// Describes the fields we want to read in the input file
-enum ColIndex : char { CI_Week, CI_Day, CI_Duration, CI_Instructor, CI_Module };
+/**
+The first CI_NbCols ones are always needed, the others only for some reports (see readBookings()).
+*/
+enum ColIndex : char {
+	CI_Week, CI_Day, CI_Duration, CI_Instructor, CI_Module,
+	CI_NbCols,
+	CI_Start = CI_NbCols, CI_End, CI_Room
+};
 
 //-------------------------------------------------------------------
 /// Unused at present, wil be used to read these in .ini file, see Params
@@ -367,7 +1672,10 @@ std::map<ColIndex,std::string> g_colIndexStr = {
 	{ CI_Day,        "colJour"    },
 	{ CI_Duration,   "colDuree"   },
 	{ CI_Instructor, "colEns"     },
-	{ CI_Module,     "colModule"  }
+	{ CI_Module,     "colModule"  },
+	{ CI_Start,      "colDebut"   },
+	{ CI_End,        "colFin"     },
+	{ CI_Room,       "colSalle"   }
 };
 
 //-------------------------------------------------------------------
@@ -377,19 +1685,26 @@ struct Params
 	char delimiter_in = ';';
 	char commentChar = '#';
 	std::map<ColIndex,int> colIndex;
-	bool        groupKey1      = false;
-	bool        groupKey2      = false;
-	int         groupKey1_pos  = 4; ///< char position of group level 1
-	int         groupKey2_pos  = 5; ///< char position of group level 2
-	std::string groupKey1_name = "Semestre";
-	std::string groupKey2_name = "UE";
-	std::map<char,std::string> groupKey1_pairs;
-	std::map<char,std::string> groupKey2_pairs;
+	std::vector<GroupLevel> groupLevels = {   ///< keys "groupKey1", "groupKey2", ... of the ini file
+		{ false, 4, "Semestre", {} },
+		{ false, 5, "UE",       {} }
+	};
 
 	std::string inputFileName;
 	std::string rootFileName;
+	std::string rootPrefix;     ///< added before the input file name in the output file names, see batchRootPrefixes()
 
-	std::array<char,3> courseTypeKeys; /// <holds the characters used to encode the course-type in input file.
+	bool        conflicts = false;   ///< if true, also writes the conflicts report, see writeConflicts()
+	unsigned    reports     = RP_All;  ///< output files to write, see EN_Report and setReports()
+	bool        atomicWrite = false;   ///< if true, the output files are written to a temporary file, renamed when complete
+	bool        roomReport  = false;   ///< if true, also writes the room occupancy report, see writeRooms()
+	int         roomOpening = 8*60;    ///< opening time of the rooms, in minutes since midnight, see writeRooms()
+	int         roomClosing = 20*60;
+	bool        weekRange = false;   ///< if true, the output files only cover weeks weekFirst to weekLast, see setWeekRange()
+	size_t      weekFirst = 0;
+	size_t      weekLast  = Presence::NbWeeks-1;
+
+	std::array<char,3> courseTypeKeys = { 'C', 'D', 'P' }; /// <holds the characters used to encode the course-type in input file.
 
 	private:
 		boost::property_tree::ptree _ptree;
@@ -411,22 +1726,24 @@ struct Params
 		if( hasIniFile )
 		{
 			std::cout << "reading data in config file " << filename << '\n';
-			groupKey1 = (bool)_ptree.get<int>( "grouping.groupKey1", groupKey1 );
-			groupKey2 = (bool)_ptree.get<int>( "grouping.groupKey2", groupKey2 );
-
-			groupKey1_name = _ptree.get<std::string>( "grouping.groupKey1_name", groupKey1_name );
-			groupKey2_name = _ptree.get<std::string>( "grouping.groupKey2_name", groupKey2_name );
-
-			groupKey1_pos = _ptree.get<int>( "grouping.groupKey1_pos", groupKey1_pos );
-			groupKey2_pos = _ptree.get<int>( "grouping.groupKey2_pos", groupKey2_pos );
-
-			std::string pairs_1 = _ptree.get<std::string>( "grouping.groupKey1_pairs", std::string() );
-			std::string pairs_2 = _ptree.get<std::string>( "grouping.groupKey2_pairs", std::string() );
+			for( size_t lev=0; ; lev++ )    // levels after the 2 default ones exist only if their position is given
+			{
+				auto key = "grouping.groupKey" + std::to_string( lev+1 );
+				if( lev >= groupLevels.size() )
+				{
+					if( !_ptree.get_optional<int>( key + "_pos" ) )
+						break;
+					groupLevels.push_back( GroupLevel{ false, 0, "Niveau " + std::to_string( lev+1 ), {} } );
+				}
+				auto& level = groupLevels[lev];
+				level.enabled = (bool)_ptree.get<int>( key, level.enabled );
+				level.name    = _ptree.get<std::string>( key + "_name", level.name );
+				level.pos     = _ptree.get<int>( key + "_pos", level.pos );
 
-			if( !pairs_1.empty() )
-				groupKey1_pairs = extractPairs( pairs_1 );
-			if( !pairs_2.empty() )
-				groupKey2_pairs = extractPairs( pairs_2 );
+				std::string pairs = _ptree.get<std::string>( key + "_pairs", std::string() );
+				if( !pairs.empty() )
+					level.pairs = extractPairs( pairs );
+			}
 
 			for( const auto& map_key: g_colIndexStr)
 				colIndex[map_key.first] = _ptree.get<int>( "columns." + map_key.second, colIndex[map_key.first] );
@@ -434,6 +1751,11 @@ struct Params
 			courseTypeKeys[TY_CM] = _ptree.get<std::string>( "courseType.courseTypeKey_CM", "C" ).at(0);
 			courseTypeKeys[TY_TD] = _ptree.get<std::string>( "courseType.courseTypeKey_TD", "D" ).at(0);
 			courseTypeKeys[TY_TP] = _ptree.get<std::string>( "courseType.courseTypeKey_TP", "P" ).at(0);
+
+			roomOpening = getTimeOfDay( _ptree.get<std::string>( "rooms.openingTime", "08h00" ) );
+			roomClosing = getTimeOfDay( _ptree.get<std::string>( "rooms.closingTime", "20h00" ) );
+			if( roomOpening < 0 || roomOpening >= roomClosing || roomClosing > 24*60 )
+				throw std::runtime_error( "Error, invalid room opening/closing times in " + filename );
 		}
 	}
 	/// Constructor, assigns default values
@@ -444,12 +1766,27 @@ struct Params
 		colIndex[CI_Duration]   = 2;
 		colIndex[CI_Instructor] = 6;
 		colIndex[CI_Module]     = 8;
+		colIndex[CI_Start]      = 3;
+		colIndex[CI_End]        = 4;
+		colIndex[CI_Room]       = 7;
+	}
+/// Returns a string holding the parameters that have an effect on how the input file is read (see SnapshotKey)
+	std::string inputSignature() const
+	{
+		std::ostringstream oss;
+		oss << delimiter_in << commentChar;
+		for( const auto& ci: colIndex )
+			if( ci.first < CI_NbCols )
+				oss << ';' << (int)ci.first << ':' << ci.second;
+		oss << ';' << courseTypeKeys[0] << courseTypeKeys[1] << courseTypeKeys[2];
+		return oss.str();
 	}
+/// Returns the highest index of the columns that are always needed
 	size_t getHighestIndex() const
 	{
 		return std::max_element(
 			std::begin(colIndex),
-			std::end(colIndex),
+			colIndex.find( CI_NbCols ),
 			[]     // lambda
 			( const std::pair<ColIndex,int> & p1, const std::pair<ColIndex,int> & p2 )
 			{
@@ -460,31 +1797,109 @@ struct Params
 	void assignFileName( std::string fn_in )
 	{
 		inputFileName = fn_in;
-		auto fn2 = split_string( fn_in, '.' );
+		auto fn2 = split_string( std::filesystem::path( fn_in ).filename().string(), '.' );  // output files are written in current folder
 		if( fn2.size() != 2 )
 			throw std::runtime_error( "Invalid input file name, must have an extension and single dot" );
-		rootFileName = fn2[0];
+		rootFileName = rootPrefix + fn2[0];
+		if( weekRange )
+		{
+			auto range = std::to_string( weekFirst ) + '-' + std::to_string( weekLast );
+			rootFileName  += "_S" + range;
+			inputFileName += " (semaines " + range + ')';
+		}
+	}
+/// Sets the range of weeks from a string "A-B" (or "A" for a single week)
+	void setWeekRange( std::string str )
+	{
+		auto pos = str.find( '-' );
+		try
+		{
+			weekFirst = std::stoul( str.substr( 0, pos ) );
+			weekLast  = ( pos == std::string::npos ? weekFirst : std::stoul( str.substr( pos+1 ) ) );
+		}
+		catch( const std::exception& )
+		{
+			weekLast = Presence::NbWeeks;
+		}
+		if( weekFirst > weekLast || weekLast >= Presence::NbWeeks )
+			throw std::runtime_error( "Error, invalid week range (expected A-B, with A <= B < " + std::to_string(Presence::NbWeeks) + "): " + str );
+		weekRange = true;
+	}
+/// Sets the output files to write from a comma-separated list, for example "E,ME"
+	void setReports( std::string str )
+	{
+		reports = 0;
+		for( const auto& name: split_string( str, ',' ) )
+		{
+			if( name == "E" )
+				reports |= RP_E;
+			else if( name == "M" )
+				reports |= RP_M;
+			else if( name == "ME" )
+				reports |= RP_ME;
+			else if( name == "EM" )
+				reports |= RP_EM;
+			else if( name == "EW" )
+				reports |= RP_EW;
+			else if( name == "MW" )
+				reports |= RP_MW;
+			else
+				throw std::runtime_error( "Error, unknown report '" + name + "', expected a list of E, M, ME, EM, EW, MW: " + str );
+		}
+		if( reports == 0 )
+			throw std::runtime_error( "Error, no report given: " + str );
+	}
+/// Number of grouping levels to use: the enabled ones, up to the first disabled one
+	size_t nbGroupLevels() const
+	{
+		size_t nb = 0;
+		while( nb < groupLevels.size() && groupLevels[nb].enabled )
+			nb++;
+		return nb;
 	}
 	friend std::ostream& operator << ( std::ostream& f, const Params& p )
 	{
 		f << "Input File parameters:"
 			<< "\n -input file delimiter='" << p.delimiter_in   << '\''
 			<< "\n -input file comment character='" << p.commentChar << '\''
-			<< "\n - grouping:" << std::boolalpha
-			<< "\n  - key1: " << p.groupKey1 << ", pos=" << p.groupKey1_pos << ", name=" << p.groupKey1_name;
-		printKeyPairs( f, p.groupKey1_pairs );
-		f << "\n  - key2: " << p.groupKey2 << ", pos=" << p.groupKey2_pos << ", name=" << p.groupKey2_name;
-		printKeyPairs( f, p.groupKey2_pairs );
+			<< "\n - grouping:" << std::boolalpha;
+		for( size_t lev=0; lev<p.groupLevels.size(); lev++ )
+		{
+			const auto& level = p.groupLevels[lev];
+			f << "\n  - key" << lev+1 << ": " << level.enabled << ", pos=" << level.pos << ", name=" << level.name;
+			printKeyPairs( f, level.pairs );
+		}
 
 		f << "\n -input file indexes:\n";
 		for( size_t i=0; i<g_colIndexStr.size(); i++ )
 			f << "  -" << g_colIndexStr[(ColIndex)i] << ": " << p.colIndex.at((ColIndex)i) << '\n';
 		f << " -highest index = " << p.getHighestIndex() << '\n';
+		if( p.weekRange )
+			f << " -weeks: " << p.weekFirst << '-' << p.weekLast << '\n';
 		return f;
 	}
 };
 //-------------------------------------------------------------------
-/// Returns type of course and course code from string
+/// Course type associated to each possible character, built from Params::courseTypeKeys, see getTypeModule()
+class CourseTypeTable
+{
+	public:
+		explicit CourseTypeTable( const Params& params )
+		{
+			_types.fill( -1 );
+			for( size_t i=0; i<3; i++ )
+				_types[ static_cast<unsigned char>( params.courseTypeKeys[i] ) ] = static_cast<signed char>( i );
+		}
+/// Returns the course type encoded by \c c, or -1 if none
+		int get( char c ) const
+		{
+			return _types[ static_cast<unsigned char>( c ) ];
+		}
+	private:
+		std::array<signed char,256> _types;
+};
+//-------------------------------------------------------------------
+/// Returns type of course and course code from string
 /**
 The course code embeds the type: CM/TD/TP, coded as last character.
 For example:
@@ -492,85 +1907,82 @@ For example:
  - \c ABC1234C => C means CM
  - \c ABC1234P => P means TP
 
-The character used to encode the course type can be changed, see Params
+The character used to encode the course type can be changed, see Params and CourseTypeTable
 */
-std::pair<EN_CourseType,std::string>
-getTypeModule( std::string in, const Params& params )
+std::pair<EN_CourseType,std::string_view>
+getTypeModule( std::string_view in, const CourseTypeTable& types )
 {
 	if( in.size()<2 )
-		throw std::runtime_error( "Module code must be at least 2 characters:'" + in + "', size=" + std::to_string(in.size() ) );
+		throw std::runtime_error( "Module code must be at least 2 characters:'" + std::string(in) + "', size=" + std::to_string(in.size() ) );
 
-	EN_CourseType ty;
 	char ct_char = in.back();
+	auto ty = types.get( ct_char );
+	if( ty < 0 )
+		throw std::runtime_error( "invalid character in module code for course type: '" + std::string( 1, ct_char ) + '\'' );
 
-	bool found = false;
-	for( size_t i=0; i<3; i++ )
-		if( ct_char == params.courseTypeKeys[i] )
-		{
-			ty = (EN_CourseType)i;
-			found = true;
-		}
-	if( !found )
-		throw std::runtime_error( "invalid character in module code for course type: '" + ct_char + '\'' );
-
-	std::string module = in.substr( 0, in.size()-1 );
-	return std::make_pair( ty, module );
+	return std::make_pair( (EN_CourseType)ty, in.substr( 0, in.size()-1 ) );
 }
 //-------------------------------------------------------------------
 /// From https://stackoverflow.com/a/4063229/193789
 /// DOES NOT WORK ???
 size_t
-getStringSize_utf8( std::string str )
+getStringSize_utf8( std::string_view str )
 {
 	size_t len=0;
-	auto s = str.c_str();
-	while( *s )
-		len += (*s++ & 0xc0) != 0x80;
+	for( auto c: str )
+		len += (c & 0xc0) != 0x80;
 	return len;
 }
 //-------------------------------------------------------------------
 /// Returns the max size of the string in key
 size_t
-findMaxStringSize( const ResourceVolumeMap& rvm )
+findMaxStringSize( const ResourceVolumeMap& rvm, const StringInterner& colNames )
 {
 	size_t res=0;
-	for( const auto& elem1: rvm )
+	for( size_t row=0; row<rvm.nbRows(); row++ )
 	{
-		using PairType = std::pair<std::string,Triplet>;
 		const auto it = std::max_element(
-			std::begin( elem1.second ),
-			std::end(   elem1.second ),
-			[]                                               // lambda
-			( const PairType& p1, const PairType& p2 )
+			std::begin( rvm._colIds ) + rvm._rowStart[row],
+			std::begin( rvm._colIds ) + rvm._rowStart[row+1],
+			[&colNames]                                      // lambda
+			( uint32_t id1, uint32_t id2 )
 			{
 #if 0
-				return p1.first.size() < p2.first.size();
+				return colNames.name(id1).size() < colNames.name(id2).size();
 #else
-				return getStringSize_utf8(p1.first) < getStringSize_utf8(p2.first);
+				return getStringSize_utf8( colNames.name(id1) ) < getStringSize_utf8( colNames.name(id2) );
 #endif
 			}
 		);
-		res = std::max( res, it->first.size() );
+		res = std::max( res, colNames.name(*it).size() );
 	}
 	return res;
 }
 //-------------------------------------------------------------------
-//template<typename T>
+/// Prints the rows \c rows of \c rvm
 Triplet
-printMap( std::ofstream& file, const std::map<std::string,TripletMap>& mapData, std::string text, size_t max_size )
+printMap(
+	OutBuffer&                 file,
+	const ResourceVolumeMap&   rvm,
+	const std::vector<size_t>& rows,
+	const StringInterner&      rowNames,
+	const StringInterner&      colNames,
+	std::string                text,
+	size_t                     max_size
+)
 {
 	Triplet sum;
-	for( const auto& elem: mapData )
+	for( auto row: rows )
 	{
-		file << "- " << text << ": " << elem.first << '\n';
-		auto s = printTripletMap( file, elem.second, max_size );
+		file << "- " << text << ": " << rowNames.name( rvm._rowIds[row] ) << '\n';
+		auto s = printTripletMap( file, rvm, row, colNames, max_size );
 		sum += s;
 	}
 	return sum;
 }
 //-------------------------------------------------------------------
 void
-printGroupKeyLabel( std::ostream& file, char key, const std::map<char,std::string>& key_map_string )
+printGroupKeyLabel( OutBuffer& file, char key, const std::map<char,std::string>& key_map_string )
 {
 	if( 0==key_map_string.count(key) || key_map_string.at(key).empty() )
 		file << key;
@@ -578,254 +1990,2400 @@ printGroupKeyLabel( std::ostream& file, char key, const std::map<char,std::strin
 		file << key_map_string.at(key);
 }
 //-------------------------------------------------------------------
+/// What a snapshot holds besides the instructor names and the volume of each pair, see Data::snapshotContent()
+enum EN_SnapshotContent : uint64_t {
+	SC_Weekly      = 1,   ///< volume of each pair in each week, see PairVolumes::keepWeekly()
+	SC_Modules     = 2,   ///< module names, the pairs being identified by module ID (else by module name, see PairVolumes::keyByName())
+	SC_Instructors = 4,   ///< days and ResourceData of the instructors
+	SC_ModuleData  = 8    ///< days and ResourceData of the modules
+};
+
+/// Serializes trivially copyable values into a byte buffer, see Data::save()
+/**
+The values must have no padding bytes, as these are not initialized and would make two snapshots
+of the same data differ, so structs like ResourceData are written field by field.
+*/
+class SnapshotWriter
+{
+	public:
+		template<typename T>
+		void put( const T& value )
+		{
+			putArray( &value, 1 );
+		}
+		template<typename T>
+		void putArray( const T* values, size_t nb )
+		{
+			static_assert( std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable" );
+			static_assert( std::has_unique_object_representations<T>::value, "snapshot values must not have padding bytes" );
+			_buffer.append( reinterpret_cast<const char*>( values ), nb*sizeof(T) );
+		}
+		void putString( std::string_view str )
+		{
+			put( static_cast<uint32_t>( str.size() ) );
+			_buffer.append( str );
+		}
+		const std::string& buffer() const
+		{
+			return _buffer;
+		}
+
+	private:
+		std::string _buffer;
+};
+//-------------------------------------------------------------------
+/// Reads back values written by SnapshotWriter, throws if the buffer is too short
+class SnapshotReader
+{
+	public:
+		explicit SnapshotReader( std::string_view buffer ): _buffer( buffer )
+		{}
+		template<typename T>
+		T get()
+		{
+			T value;
+			getArray( &value, 1 );
+			return value;
+		}
+		template<typename T>
+		void getArray( T* values, size_t nb )
+		{
+			static_assert( std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable" );
+			auto sz = nb*sizeof(T);
+			check( sz );
+			std::memcpy( static_cast<void*>( values ), _buffer.data()+_pos, sz );
+			_pos += sz;
+		}
+		std::string_view getString()
+		{
+			auto sz = get<uint32_t>();
+			check( sz );
+			auto str = _buffer.substr( _pos, sz );
+			_pos += sz;
+			return str;
+		}
+/// Number of items that can still be read, used to check sizes before allocating
+		template<typename T>
+		size_t remaining() const
+		{
+			return ( _buffer.size() - _pos ) / sizeof(T);
+		}
+
+	private:
+		void check( size_t sz ) const
+		{
+			if( sz > _buffer.size() - _pos )
+				throw std::runtime_error( "snapshot is truncated" );
+		}
+		std::string_view _buffer;
+		size_t           _pos = 0;
+};
+//-------------------------------------------------------------------
 /// Holds all the data read from the file, along with the processing functions
+/**
+Instructors and modules are identified by an ID (see StringInterner), all the containers are indexed by these.
+*/
 struct Data
 {
-	ResourceDataMap _instructorData;  ///< key: instructor name
-	ResourceDataMap _moduleData;      ///< key: module name
+	StringInterner _instructors;
+	StringInterner _modules;
+
+	ResourceDataMap _instructorData;  ///< index: instructor ID
+	ResourceDataMap _moduleData;      ///< index: module ID
 
 	ResourceDays _instructorDays;
 	ResourceDays _moduleDays;
 
+/// Resources that have new events since the last call to compute(), index: resource ID
+	std::vector<char> _instructorDirty;
+	std::vector<char> _moduleDirty;
+
+	PairVolumes _volumes;             ///< filled while reading, used to build the two matrices below
+
 	ResourceVolumeMap _mod_prof;
 	ResourceVolumeMap _prof_mod;
 
+	WeekMatrix _instructorWeeks;      ///< only if the "EW" file is selected, see writeWeekly()
+	WeekMatrix _moduleWeeks;          ///< only if the "MW" file is selected
+
+	unsigned _reports      = RP_All;  ///< output files to compute, see select()
+	bool     _instructorSide = true;  ///< if false, the days of the instructors and their ResourceData are not computed
+	bool     _moduleSide     = true;  ///< same for the modules
+
+/// Selects the output files to compute (see EN_Report), must be called before reading the data
+/**
+The matrices are only built if their report is selected, and the days and ResourceData of the instructors
+(resp. the modules) are not even computed while reading when the "E" (resp. "M") file is not selected.
+When no report needs the modules (only "E" and "EW"), they are not interned either, see PairVolumes::keyByName().
+A snapshot only holds what has been computed, see snapshotContent().
+
+The volume of each week is only kept if \c weekRange is true (see restrictToWeeks()) or if a weekly report is selected.
+*/
+	void select( unsigned reports, bool weekRange )
+	{
+		_reports        = reports;
+		_instructorSide = reports & RP_E;
+		_moduleSide     = reports & RP_M;
+		if( weekRange || ( reports & ( RP_EW | RP_MW ) ) )
+			_volumes.keepWeekly();
+		if( !( reports & ( RP_M | RP_ME | RP_EM | RP_MW ) ) )
+			_volumes.keyByName();
+	}
+/// Makes the same selection as \c other, see select()
+	void selectLike( const Data& other )
+	{
+		_reports        = other._reports;
+		_instructorSide = other._instructorSide;
+		_moduleSide     = other._moduleSide;
+		if( other._volumes.hasWeekly() )
+			_volumes.keepWeekly();
+		if( other._volumes.byName() )
+			_volumes.keyByName();
+	}
+/// Removes all the data, keeps the selection done with select()
+	void clear()
+	{
+		Data empty;
+		empty.selectLike( *this );
+		*this = std::move( empty );
+	}
+
 /// Add one event to the data
-	void addOne( std::string instr, size_t num_sem, EN_WeekDay wd, const std::pair<EN_CourseType,std::string>& type_mod, float duration )
+	void addOne( std::string_view instr, size_t num_sem, EN_WeekDay wd, const std::pair<EN_CourseType,std::string_view>& type_mod, float duration )
 	{
 		assert( !instr.empty() );
+		if( num_sem >= Presence::NbWeeks )
+			throw std::runtime_error( "Week number must be lower than " + std::to_string(Presence::NbWeeks) + ", read: " + std::to_string(num_sem) );
 
-		auto type   = type_mod.first;
-		auto module = type_mod.second;
-
+		Triplet tri( type_mod.first, duration );
+		auto id_ins = _instructors.intern( instr );
+		if( _instructorSide )
 		{
-			auto& ref_inst = _instructorDays[instr];
-			auto& ref_week = ref_inst[num_sem];
-			ref_week.insert( wd );
+			if( id_ins == _instructorDays.size() )
+			{
+				_instructorDays.emplace_back();
+				_instructorDirty.emplace_back();
+			}
+			_instructorDirty[id_ins] = 1;
+			_instructorDays[id_ins].set( num_sem, wd );
 		}
-
+		if( _volumes.byName() )
 		{
-			auto& ref_mod = _moduleDays[module];
-			auto& ref_week = ref_mod[num_sem];
-			ref_week.insert( wd );
+			_volumes.add( _volumes.index( type_mod.second, id_ins ), num_sem, tri );
+			return;
 		}
 
-		auto tri = Triplet( type, duration );
-
-		auto& mod1 = _mod_prof[module];
-		auto& pr1  =  mod1[instr];
-		pr1 += tri;
+		auto id_mod = _modules.intern( type_mod.second );
+		if( _moduleSide )
+		{
+			if( id_mod == _moduleDays.size() )
+			{
+				_moduleDays.emplace_back();
+				_moduleDirty.emplace_back();
+			}
+			_moduleDirty[id_mod] = 1;
+			_moduleDays[id_mod].set( num_sem, wd );
+		}
 
-		auto& pr2  = _prof_mod[instr];
-		auto& mod2 =  pr2[module];
-		mod2 += tri;
+		_volumes.add( _volumes.index( id_mod, id_ins ), num_sem, tri );
 	}
 
-	void compute()
+/// Adds the events held in \c other, read from a subsequent part of the input file (see readData_mt())
+	void merge( const Data& other )
 	{
-		for( const auto& elem: _instructorDays )
+		std::vector<uint32_t> insMap( other._instructors.size() );
+		std::vector<uint32_t> modMap( other._modules.size() );
+		for( uint32_t id=0; id<insMap.size(); id++ )
+			insMap[id] = _instructors.intern( other._instructors.name(id) );
+		for( uint32_t id=0; id<modMap.size(); id++ )
+			modMap[id] = _modules.intern( other._modules.name(id) );
+		if( _instructorSide )
+		{
+			_instructorDays.resize( _instructors.size() );
+			_instructorDirty.resize( _instructors.size() );
+			for( auto id: insMap )
+				_instructorDirty[id] = 1;
+			mergeDays( _instructorDays, other._instructorDays, insMap );
+		}
+		if( _moduleSide )
+		{
+			_moduleDays.resize( _modules.size() );
+			_moduleDirty.resize( _modules.size() );
+			for( auto id: modMap )
+				_moduleDirty[id] = 1;
+			mergeDays( _moduleDays, other._moduleDays, modMap );
+		}
+		for( size_t i=0; i<other._volumes.size(); i++ )
 		{
-			for( const auto& sem: elem.second )
-				_instructorData[elem.first].incrementDays( sem.second.size() );
-			_instructorData[elem.first]._nbWeeks = elem.second.size();
+			auto id_ins = insMap[other._volumes.instructor(i)];
+			auto index  = _volumes.byName()
+				? _volumes.index( other._volumes.moduleName(i), id_ins )
+				: _volumes.index( modMap[other._volumes.module(i)], id_ins );
+			_volumes.addPair( index, other._volumes, i );
 		}
+	}
 
-		for( const auto& elem: _moduleDays )
+/// Computes the ResourceData of the resources that have new events since the last call
+	void computeResources()
+	{
+		if( _instructorSide )
+		{
+			_instructorData.resize( _instructors.size() );
+			for( size_t id=0; id<_instructorDays.size(); id++ )
+				if( _instructorDirty[id] )
+				{
+					_instructorData[id]._nbDays  = _instructorDays[id].nbDays();
+					_instructorData[id]._nbWeeks = _instructorDays[id].nbWeeks();
+				}
+			process( _volumes, false, _instructorDirty, _instructorData );
+		}
+		if( _moduleSide )
 		{
-			for( const auto& sem: elem.second )
-				_moduleData[elem.first].incrementDays( sem.second.size() );
-			_moduleData[elem.first]._nbWeeks = elem.second.size();
+			_moduleData.resize( _modules.size() );
+			for( size_t id=0; id<_moduleDays.size(); id++ )
+				if( _moduleDirty[id] )
+				{
+					_moduleData[id]._nbDays  = _moduleDays[id].nbDays();
+					_moduleData[id]._nbWeeks = _moduleDays[id].nbWeeks();
+				}
+			process( _volumes, true, _moduleDirty, _moduleData );
 		}
 
-		process( _prof_mod, _instructorData );
-		process( _mod_prof, _moduleData );
+		std::fill( std::begin(_instructorDirty), std::end(_instructorDirty), 0 );
+		std::fill( std::begin(_moduleDirty),     std::end(_moduleDirty),     0 );
 	}
 
-/// Write report of Modules / Instructor
+/// Computes what is needed to write the selected output files, see select()
+	void compute()
+	{
+		computeResources();
+		if( _reports & RP_EM )
+			_prof_mod = buildVolumeMatrix( _volumes, false, _instructors, _modules );
+		if( _reports & RP_ME )
+			_mod_prof = buildVolumeMatrix( _volumes, true,  _modules, _instructors );
+		if( _reports & RP_EW )
+			_instructorWeeks = buildWeekMatrix( _volumes, false, _instructors.size() );
+		if( _reports & RP_MW )
+			_moduleWeeks = buildWeekMatrix( _volumes, true, _modules.size() );
+	}
+
+/// Restricts the data to weeks \c first to \c last (included), to be called before compute(), see readInput()
 /**
-Has 2-level grouping capabilities, based on module string (only if it encodes some information)
+The input data is not read again: the volumes come from the per-week volumes (see PairVolumes::restrictToWeeks()),
+so the week range must have been given to select(), and the presence of each resource is masked.
+The resources that have no events in these weeks get 0 days, and are not written in the output files.
 */
-	void writeReport_MI( std::string fn, const Params& params )
+	void restrictToWeeks( size_t first, size_t last )
 	{
-		auto file = openFile( fn + params.rootFileName + ".txt", "", params.inputFileName );
-		file << g_rule << "Bilan par module\n" << g_rule;
-		auto max_size = findMaxStringSize( _mod_prof );
+		auto mask = weekMask( first, last );
+		for( auto& days: _instructorDays )
+			days.mask( mask );
+		for( auto& days: _moduleDays )
+			days.mask( mask );
+		_volumes.restrictToWeeks( first, last );
+
+		std::fill( std::begin(_instructorDirty), std::end(_instructorDirty), 1 );
+		std::fill( std::begin(_moduleDirty),     std::end(_moduleDirty),     1 );
+	}
+/// Content of a snapshot written by save(), see EN_SnapshotContent
+	uint64_t snapshotContent() const
+	{
+		uint64_t content = 0;
+		if( _volumes.hasWeekly() )
+			content |= SC_Weekly;
+		if( !_volumes.byName() )
+			content |= SC_Modules;
+		if( _instructorSide )
+			content |= SC_Instructors;
+		if( _moduleSide )
+			content |= SC_ModuleData;
+		return content;
+	}
+
+/// Writes the data read from the input file into \c snap, see saveSnapshot()
+/**
+Must be called after computeResources(), the matrices are not saved but the ResourceData are,
+so that after load() only the resources that get new events need to be computed again.
+Only what has been computed is saved (see snapshotContent()): the days and ResourceData of the selected sides,
+the module names if the pairs use module IDs, and the volumes of the pairs week by week if they are kept.
+*/
+	void save( SnapshotWriter& snap ) const
+	{
+		snap.put( static_cast<uint64_t>( _instructors.size() ) );
+		for( uint32_t id=0; id<_instructors.size(); id++ )
+			snap.putString( _instructors.name(id) );
+		if( !_volumes.byName() )
+		{
+			snap.put( static_cast<uint64_t>( _modules.size() ) );
+			for( uint32_t id=0; id<_modules.size(); id++ )
+				snap.putString( _modules.name(id) );
+		}
+		if( _instructorSide )
+		{
+			assert( _instructorData.size() == _instructors.size() );
+			snap.putArray( _instructorDays.data(), _instructorDays.size() );
+			for( const auto& rd: _instructorData )
+				putResourceData( snap, rd );
+		}
+		if( _moduleSide )
+		{
+			assert( _moduleData.size() == _modules.size() );
+			snap.putArray( _moduleDays.data(), _moduleDays.size() );
+			for( const auto& rd: _moduleData )
+				putResourceData( snap, rd );
+		}
 
-		Triplet bigsum;
-		if( params.groupKey1 )
+		snap.put( static_cast<uint64_t>( _volumes.size() ) );
+		for( size_t i=0; i<_volumes.size(); i++ )
+		{
+			if( _volumes.byName() )
+				snap.putString( _volumes.moduleName(i) );
+			else
+				snap.put( _volumes.module(i) );
+			snap.put( _volumes.instructor(i) );
+			auto weeks = _volumes.weeks(i);
+			snap.put( weeks );
+			if( !_volumes.hasWeekly() )
+				snap.put( _volumes.volume(i) );
+			else
+				for( size_t w=0; w<Presence::NbWeeks; w++ )
+					if( weeks & ( uint64_t(1) << w ) )
+						snap.put( _volumes.weekly(i)[w] );
+		}
+	}
+/// Reads back data written by save(), with content \c content (see snapshotContent()), throws if \c snap is inconsistent
+/**
+The snapshot must hold everything this object needs (see loadSnapshot()), but may hold more:
+the days and ResourceData of an unselected side are dropped, the modules IDs are replaced by their names if
+the pairs are identified by name, and the per-week volumes are summed if they are not needed.
+*/
+	void load( SnapshotReader& snap, uint64_t content )
+	{
+		clear();
+		auto nbIns = snap.get<uint64_t>();
+		for( uint64_t i=0; i<nbIns; i++ )
+			_instructors.intern( snap.getString() );
+		if( _instructors.size() != nbIns )
+			throw std::runtime_error( "snapshot is inconsistent" );
+		uint64_t nbMod = 0;
+		std::vector<std::string_view> modNames;       // only if the pairs are identified by name
+		if( content & SC_Modules )
 		{
-			auto mapLevel_1 = distributeMap( _mod_prof, params.groupKey1_pos );
-			for( const auto& elem1: mapLevel_1 )
+			nbMod = snap.get<uint64_t>();
+			for( uint64_t i=0; i<nbMod; i++ )
 			{
-				Triplet sumLevel_1;
-				file << "*** " << params.groupKey1_name << ": ";
-				printGroupKeyLabel( file, elem1.first, params.groupKey1_pairs );
-				file << " ***\n\n";
-				const auto current = elem1.second;
-				if( params.groupKey2 )
-				{
-					Triplet sumLevel_2;
-					auto mapLevel_2 = distributeMap( current, params.groupKey2_pos );
-					for( const auto& elem2: mapLevel_2 )
-					{
-						file << "** " << params.groupKey2_name << ": ";
-						printGroupKeyLabel( file, elem2.first, params.groupKey2_pairs );
-						file << " **\n\n";
-						auto tot = printMap( file, elem2.second, "module", max_size );
-						file << "* Total " << params.groupKey2_name << ' ';
-						printGroupKeyLabel( file, elem2.first, params.groupKey2_pairs );
-						file << ": ";
-						tot.printAsText( file );
-						file << "\n\n";
-						bigsum     += tot;
-						sumLevel_1 += tot;
-					}
-				}
+				auto name = snap.getString();
+				if( _volumes.byName() )
+					modNames.push_back( name );
 				else
+					_modules.intern( name );
+			}
+			if( !_volumes.byName() && _modules.size() != nbMod )
+				throw std::runtime_error( "snapshot is inconsistent" );
+		}
+		if( content & SC_Instructors )
+			loadResources( snap, nbIns, _instructorSide, _instructorDays, _instructorData );
+		if( content & SC_ModuleData )
+			loadResources( snap, nbMod, _moduleSide, _moduleDays, _moduleData );
+		_instructorDirty.assign( _instructorDays.size(), 0 );
+		_moduleDirty.assign( _moduleDays.size(), 0 );
+
+		auto nbPairs = snap.get<uint64_t>();
+		for( uint64_t i=0; i<nbPairs; i++ )
+		{
+			auto id_mod = PairVolumes::NoModule;
+			std::string_view name;
+			if( content & SC_Modules )
+				id_mod = snap.get<uint32_t>();
+			else
+				name = snap.getString();
+			auto id_ins = snap.get<uint32_t>();
+			auto weeks  = snap.get<uint64_t>();
+			if( ( ( content & SC_Modules ) && id_mod >= nbMod ) || id_ins >= nbIns )
+				throw std::runtime_error( "snapshot is inconsistent" );
+			size_t index;
+			if( !_volumes.byName() )
+				index = _volumes.index( id_mod, id_ins );
+			else
+				index = _volumes.index( ( content & SC_Modules ) ? modNames[id_mod] : name, id_ins );
+
+			if( !( content & SC_Weekly ) )
+			{
+				_volumes.addTotal( index, weeks, snap.get<Triplet>() );
+				continue;
+			}
+			std::array<Triplet,Presence::NbWeeks> weekly;
+			Triplet total;
+			for( size_t w=0; w<Presence::NbWeeks; w++ )
+				if( weeks & ( uint64_t(1) << w ) )
 				{
-					auto tot = printMap( file, current, "module", max_size );
-					bigsum     += tot;
-					sumLevel_1 += tot;
+					weekly[w] = snap.get<Triplet>();
+					total += weekly[w];
 				}
-				file << "* Total " << params.groupKey1_name << ' ';
-				printGroupKeyLabel( file, elem1.first, params.groupKey1_pairs );
-				file << ": ";
-				sumLevel_1.printAsText( file );
-				file << "\n\n";
-			}
+			if( _volumes.hasWeekly() )
+				_volumes.addWeekly( index, weeks, weekly.data() );
+			else
+				_volumes.addTotal( index, weeks, total );
 		}
-		else
+	}
+/// Writes \c rd field by field, so that its padding bytes are not written, see save()
+	static void putResourceData( SnapshotWriter& snap, const ResourceData& rd )
+	{
+		snap.put( static_cast<uint64_t>( rd._nbDays ) );
+		snap.put( static_cast<uint64_t>( rd._nbWeeks ) );
+		snap.put( rd._volume );
+		snap.put( static_cast<uint64_t>( rd._nbOtherResources ) );
+	}
+/// Reads the days and ResourceData of \c nb resources from \c snap, keeps them only if \c keep is true, see load()
+	static void loadResources( SnapshotReader& snap, size_t nb, bool keep, ResourceDays& days, ResourceDataMap& data )
+	{
+		if( nb > snap.remaining<Presence>() )
+			throw std::runtime_error( "snapshot is inconsistent" );
+		days.resize( nb );
+		snap.getArray( days.data(), nb );
+		if( nb > snap.remaining<Triplet>() )      // each ResourceData takes more than a Triplet
+			throw std::runtime_error( "snapshot is inconsistent" );
+		data.resize( nb );
+		for( auto& rd: data )
 		{
-			auto tot = printMap( file, _mod_prof, "module", max_size );
-			bigsum  += tot;
+			rd._nbDays           = snap.get<uint64_t>();
+			rd._nbWeeks          = snap.get<uint64_t>();
+			rd._volume           = snap.get<Triplet>();
+			rd._nbOtherResources = snap.get<uint64_t>();
 		}
+		if( !keep )
+		{
+			ResourceDays().swap( days );
+			ResourceDataMap().swap( data );
+		}
+	}
+
+/// Write report of Modules / Instructor
+/**
+Has N-level grouping capabilities, based on module string (only if it encodes some information), see Params::groupLevels
+*/
+	OutBuffer writeReport_MI( std::string fn, const Params& params ) const
+	{
+		auto file = openFile( fn + params.rootFileName + ".txt", "", params.inputFileName, params.atomicWrite );
+		file << g_rule << "Bilan par module\n" << g_rule;
+		auto max_size = findMaxStringSize( _mod_prof, _instructors );
+
+		auto tree = buildGroupTree( _mod_prof, _modules, params.groupLevels, params.nbGroupLevels() );
+		printGroup( file, tree, 0, 0, max_size, params );
+
 		file << "\n*** TOTAL GENERAL ***\n";
-		bigsum.printAsText( file );
+		tree._nodes[0]._volume.printAsText( file );
 		file << "\n";
+		return file;
+	}
+
+/// Prints the groups of node \c node of \c tree, at depth \c depth, with their subtotals, see writeReport_MI()
+	void printGroup( OutBuffer& file, const GroupTree& tree, uint32_t node, size_t depth, size_t max_size, const Params& params ) const
+	{
+		const auto& nd = tree._nodes[node];
+		if( nd._children.empty() )
+		{
+			printMap( file, _mod_prof, nd._rows, _modules, _instructors, "module", max_size );
+			return;
+		}
+		const auto& level = params.groupLevels[depth];
+		std::string stars( std::max( size_t(3), params.nbGroupLevels()+1 ) - depth, '*' );   // "***" for the first level
+		for( auto child: nd._children )
+		{
+			auto key = tree._nodes[child]._key;
+			file << stars << ' ' << level.name << ": ";
+			printGroupKeyLabel( file, key, level.pairs );
+			file << ' ' << stars << "\n\n";
+			printGroup( file, tree, child, depth+1, max_size, params );
+			file << "* Total " << level.name << ' ';
+			printGroupKeyLabel( file, key, level.pairs );
+			file << ": ";
+			tree._nodes[child]._volume.printAsText( file );
+			file << "\n\n";
+		}
 	}
 
 /// write report of Instructor / Modules
-	void writeReport_IM( std::string fn, const Params& params )
+	OutBuffer writeReport_IM( std::string fn, const Params& params ) const
 	{
-		auto file = openFile( fn + params.rootFileName + ".txt", "", params.inputFileName );
+		auto file = openFile( fn + params.rootFileName + ".txt", "", params.inputFileName, params.atomicWrite );
 		file << g_rule << "Bilan par enseignant\n" << g_rule;
 
-		auto max_size = findMaxStringSize( _prof_mod );
+		auto max_size = findMaxStringSize( _prof_mod, _modules );
 //		std::cout << __FUNCTION__ << "(): max_size=" << max_size << '\n';
 
-		Triplet bigsum;
-		for( const auto& elem1: _prof_mod )
+		for( size_t row=0; row<_prof_mod.nbRows(); row++ )
 		{
-			file << "Enseignant:" << elem1.first << '\n';
-			bigsum += printTripletMap( file, elem1.second, max_size );
+			file << "Enseignant:" << _instructors.name( _prof_mod._rowIds[row] ) << '\n';
+			printTripletMap( file, _prof_mod, row, _modules, max_size );
 		}
 		file << "\n*** TOTAL GENERAL ***\n";
-		bigsum.printAsText( file );
+		_prof_mod._volumes.sum().printAsText( file );
 		file << "\n";
-
+		return file;
 	}
 
 /// write CSV data
-	void writeCsv( std::string fn, const ResourceDataMap& dataMap, std::string headline, const Params& params )
+	OutBuffer writeCsv( std::string fn, const ResourceDataMap& dataMap, const StringInterner& names, std::string headline, const Params& params ) const
 	{
-		auto file = openFile( fn + params.rootFileName + ".csv", headline, params.inputFileName );
-		for( const auto& elem: dataMap )
+		auto file = openFile( fn + params.rootFileName + ".csv", headline, params.inputFileName, params.atomicWrite );
+		for( auto id: names.sortedIds() )
 		{
-			auto data = elem.second;
-			file << elem.first << g_ocs;
+			const auto& data = dataMap[id];
+			if( data._nbDays == 0 )        // no event in the selected weeks, see Data::restrictToWeeks()
+				continue;
+			file << names.name(id) << g_ocs;
 //			if( printModules )
 
 			file << data
 //				g_ocs << 1.0*data._volume.sum() / data._nbDays
 				<< '\n';
 		}
+		return file;
+	}
+
+/// Writes the volume of each resource in each week, as hours and heqTD (see Triplet::sumEqTD()), one line per resource
+	OutBuffer writeWeekly( std::string fn, const WeekMatrix& wm, const StringInterner& names, const Params& params ) const
+	{
+		std::string headline = "# Nom";
+		for( size_t w=0; w<Presence::NbWeeks; w++ )
+			if( wm._weeks & ( uint64_t(1) << w ) )
+				headline += ";S" + std::to_string( w ) + " h;S" + std::to_string( w ) + " heqTD";
+		headline += ";total h;total heqTD";
+
+		auto file = openFile( fn + params.rootFileName + ".csv", headline, params.inputFileName, params.atomicWrite );
+		for( auto id: names.sortedIds() )
+		{
+			const auto* row = wm.row( id );
+			Triplet total;
+			for( size_t w=0; w<Presence::NbWeeks; w++ )
+				total += row[w];
+			if( total.sum() == 0. )        // no event in the selected weeks
+				continue;
+			file << names.name(id);
+			for( size_t w=0; w<Presence::NbWeeks; w++ )
+				if( wm._weeks & ( uint64_t(1) << w ) )
+					file << g_ocs << row[w].sum() << g_ocs << row[w].sumEqTD();
+			file << g_ocs << total.sum() << g_ocs << total.sumEqTD() << '\n';
+		}
+		return file;
 	}
 };
 
 //-------------------------------------------------------------------
-/// see adepopro.cpp
-int main( int argc, char* argv[] )
+/// Line counts and timings of the reading of some input data, see parseData() and readData()
+struct ReadStats
 {
-	if( argc < 2 )
-	{
-		std::cout << "usage: " << argv[0] << " <input_csv_file>\n";
-		return 1;
-	}
-	std::string fn_in = argv[argc-1];
-	Params params( "adepopro.ini" ); // attemps to read in file, else keeps default values
+	size_t nbEvents      = 0;   ///< lines holding an event
+	size_t nbComments    = 0;   ///< lines starting with the comment character
+	size_t nbSkipped     = 0;   ///< lines with an empty first field
+	size_t nbEmptyModule = 0;   ///< lines with an empty module field
+	size_t nbEmpty       = 0;   ///< empty lines
+	double parseTime     = 0.;  ///< time spent reading the lines, not counting the time spent in Data::addOne() (seconds, summed over threads)
+	double addOneTime    = 0.;  ///< time spent in Data::addOne() (seconds, summed over threads)
+	double mergeTime     = 0.;  ///< time spent merging the thread shards, see readData_mt()
 
-	bool printOptions = false;
-	if( argc > 1 )
+	ReadStats& operator += ( const ReadStats& other )
 	{
-		for( int i=1; i<argc; i++ )
+		nbEvents      += other.nbEvents;
+		nbComments    += other.nbComments;
+		nbSkipped     += other.nbSkipped;
+		nbEmptyModule += other.nbEmptyModule;
+		nbEmpty       += other.nbEmpty;
+		parseTime     += other.parseTime;
+		addOneTime    += other.addOneTime;
+		mergeTime     += other.mergeTime;
+		return *this;
+	}
+};
+//-------------------------------------------------------------------
+/// Returns a duration in seconds
+double
+toSeconds( std::chrono::steady_clock::duration d )
+{
+	return std::chrono::duration<double>( d ).count();
+}
+//-------------------------------------------------------------------
+/// Column layout of the input file, built once from Params::colIndex: the needed columns, sorted by index
+/**
+Each step gives a column index and the slot (ColIndex value) where its field is stored, see extractFields().
+*/
+class ColumnPlan
+{
+	public:
+		explicit ColumnPlan( const Params& params )
 		{
-			if( std::string(argv[i]) == "-s" )
-				params.groupKey1 = true;
-			if( std::string(argv[i]) == "-p" )
-				printOptions = true;
+			for( size_t i=0; i<CI_NbCols; i++ )
+				_steps[i] = std::make_pair( params.colIndex.at( (ColIndex)i ), (ColIndex)i );
+			std::sort( std::begin(_steps), std::end(_steps) );
 		}
-	}
-	if( printOptions )
+		bool operator == ( const ColumnPlan& other ) const
+		{
+			return _steps == other._steps;
+		}
+		size_t   size()           const { return _steps.size(); }
+		int      col( size_t i )  const { return _steps[i].first; }
+		ColIndex slot( size_t i ) const { return _steps[i].second; }
+		size_t   nbFields()       const { return _steps.back().first+1; }
+
+	private:
+		std::array<std::pair<int,ColIndex>,CI_NbCols> _steps;
+};
+//-------------------------------------------------------------------
+/// Compile-time column layout, same interface as ColumnPlan, used for the fast paths of parseData()
+/**
+Template arguments are the needed column indexes in increasing order, followed by their slots.
+*/
+template<
+	int C0, int C1, int C2, int C3, int C4,
+	ColIndex S0, ColIndex S1, ColIndex S2, ColIndex S3, ColIndex S4
+>
+struct FixedColumnPlan
+{
+	static constexpr std::array<int,CI_NbCols>      _cols  = { C0, C1, C2, C3, C4 };
+	static constexpr std::array<ColIndex,CI_NbCols> _slots = { S0, S1, S2, S3, S4 };
+
+	static constexpr size_t   size()           { return CI_NbCols; }
+	static constexpr int      col( size_t i )  { return _cols[i]; }
+	static constexpr ColIndex slot( size_t i ) { return _slots[i]; }
+	static constexpr size_t   nbFields()       { return C4+1; }
+
+/// Returns true if \c plan has the same layout
+	static bool matches( const ColumnPlan& plan )
 	{
-		std::cout << argv[0] << ", version date: " << __DATE__
-			<< '\n' << params << '\n';
-		return 1;
+		for( size_t i=0; i<size(); i++ )
+			if( plan.col(i) != col(i) || plan.slot(i) != slot(i) )
+				return false;
+		return true;
 	}
+};
 
-	std::ifstream file( fn_in );
-	if( !file.is_open() )
-		throw std::runtime_error( "Error, unable to open file " + fn_in );
+/// Default layout, see Params::Params()
+typedef FixedColumnPlan<0,1,2,6,8, CI_Week,CI_Day,CI_Duration,CI_Instructor,CI_Module> DefaultColumnPlan;
 
-	Data results;
+/// Layout of the ADE export given as example in adepopro.ini
+typedef FixedColumnPlan<1,2,3,4,8, CI_Instructor,CI_Module,CI_Duration,CI_Day,CI_Week> AdeColumnPlan;
+
+//-------------------------------------------------------------------
+/// Fields of a line, indexed by ColIndex
+typedef std::array<std::string_view,CI_NbCols> LineFields;
 
-	std::string buff;
-	int line = 0;
-	while ( getline (file, buff ) )
+/// Stores in \c fields the fields of \c line at the columns given by \c plan
+/**
+\c delims holds the positions in \c line of its first delimiters (at least plan.nbFields()-1 of them, if there are),
+and \c nbDelims is the total number of delimiters in the line, see parseLines().
+The fields are the same as the ones split_string() gives: a line with n delimiters has n+1 fields,
+so a trailing delimiter gives an empty last field.
+
+Returns false if the line has less fields than plan.nbFields().
+*/
+template<typename PLAN>
+bool
+extractFields( std::string_view line, const uint32_t* delims, size_t nbDelims, const PLAN& plan, LineFields& fields )
+{
+	if( nbDelims+1 < plan.nbFields() )
+		return false;
+	for( size_t i=0; i<plan.size(); i++ )
 	{
-		line++;
-//		std::cout << "line " << line << ": " << buff << '\n';
+		size_t col   = plan.col(i);
+		size_t start = ( col == 0 ? 0 : delims[col-1]+1 );
+		size_t end   = ( col < nbDelims ? delims[col] : line.size() );
+		fields[plan.slot(i)] = line.substr( start, end-start );
+	}
+	return true;
+}
+//-------------------------------------------------------------------
+/// Prints the fields of a line that does not have enough of them, and throws
+void
+throwMissingFields( std::string_view line, const Params& params )
+{
+	auto highestIndex = params.getHighestIndex();
+	std::vector<std::string_view> v_str;
+	split_view( line, params.delimiter_in, v_str, highestIndex+1 );
+	std::cout << "erreur, champ manquants: " << v_str.size() << " au lieu de " << highestIndex << " au minimum:\n" << line << '\n';
+	for( auto s: v_str )
+		std::cout << "-" << s << '\n';
+	throw std::runtime_error("error");
+}
+//-------------------------------------------------------------------
+/// Size of the blocks of lines handled at once by parseLines()
+const size_t g_parseBlockSize = 256*1024;
 
-		auto v_str = split_string( buff, params.delimiter_in );
-		if( v_str.size() < params.getHighestIndex() && !v_str.empty() )
-		{
-			std::cout << "erreur, champ manquants: " << v_str.size() << " au lieu de " << params.getHighestIndex() << " au minimum:\n" << buff << '\n';
-			for( auto s: v_str )
-				std::cout << "-" << s << '\n';
-			throw std::runtime_error("error");
-		}
-		if( !v_str.empty() )
-		if( !v_str[0].empty() && v_str[0].front() != params.commentChar )
+/// Returns the block of complete lines of \c buffer starting at \c pos, of about g_parseBlockSize bytes
+/**
+The block ends after a newline character, or at the end of the buffer. It is larger than g_parseBlockSize only if a single line is.
+*/
+std::string_view
+nextBlock( std::string_view buffer, size_t pos )
+{
+	if( buffer.size() - pos <= g_parseBlockSize )
+		return buffer.substr( pos );
+	auto end = buffer.rfind( '\n', pos + g_parseBlockSize - 1 );
+	if( end == std::string_view::npos || end < pos )
+		end = buffer.find( '\n', pos + g_parseBlockSize );
+	return buffer.substr( pos, end == std::string_view::npos ? std::string_view::npos : end+1-pos );
+}
+//-------------------------------------------------------------------
+/// Parses the input data held in \c buffer with the column layout \c plan, see parseData()
+/**
+The buffer is handled by blocks of lines: the positions of all the delimiters and newline characters of a block
+are found at once by scanSeparators(), then each line is processed using the positions of its first delimiters.
+*/
+template<typename PLAN, typename FUNC>
+void
+parseLines( std::string_view buffer, const Params& params, const PLAN& plan, FUNC&& onEvent, ReadStats& nb )
+{
+	LineFields fields;
+	CourseTypeTable types( params );
+
+	std::vector<uint32_t> seps;                        // positions of the separators of the current block
+	std::vector<uint32_t> delims( plan.nbFields() );   // positions of the first delimiters of the current line
+
+	auto processLine = [&]( std::string_view line, size_t nbDelims )     // lambda
+	{
+		if( line.empty() )
+			nb.nbEmpty++;
+		else if( line.front() == params.delimiter_in )
+			nb.nbSkipped++;
+		else if( line.front() == params.commentChar )
+			nb.nbComments++;
+		else
 		{
-			auto week_num = getWeekNum(  v_str.at(params.colIndex[CI_Week])      );
-			auto weekday  = getWeekDay(  v_str.at(params.colIndex[CI_Day])       );
-			auto duration = getDuration( v_str.at(params.colIndex[CI_Duration])  );
-			auto name     =              v_str.at(params.colIndex[CI_Instructor] );
-			auto code     =              v_str.at(params.colIndex[CI_Module]     );
+			if( !extractFields( line, delims.data(), nbDelims, plan, fields ) )
+				throwMissingFields( line, params );
+
+			auto week_num = getWeekNum(  fields[CI_Week]     );
+			auto weekday  = getWeekDay(  fields[CI_Day]      );
+			auto duration = getDuration( fields[CI_Duration] );
+			auto name     =              fields[CI_Instructor];
+			auto code     =              fields[CI_Module];
 
 			if( !code.empty() )
 			{
-//				std::cout << "buff=" << buff << '\n';
-//				std::cout << "line=" << line << " nb champs=" << v_str.size() << " name=" << name << " day=" << (int)weekday << " weeknum=" << week_num << " code=" << code << '\n';
-				auto type_mod = getTypeModule( code, params );
-//				if( v_str.size() > 9 )
-//					std::cout << "line " << line << ": " << buff << '\n';
+				auto type_mod = getTypeModule( code, types );
 				if( name.empty() )
 					name = "(néant)";
-				results.addOne( name, week_num, weekday, type_mod, duration );
+				onEvent( name, week_num, weekday, type_mod, duration );
+				nb.nbEvents++;
 			}
+			else
+				nb.nbEmptyModule++;
 		}
-	}
-	results.compute();
-	params.assignFileName( fn_in );
+	};
 
-// csv output file headers
-	std::string head1 = "# Nom;Nb jours;Nb sem;vol. CM;vol. TD;vol. TP;vol. total;";
+	size_t pos = 0;
+	while( pos < buffer.size() )
+	{
+		auto block = nextBlock( buffer, pos );
+		pos += block.size();
+		if( seps.size() < block.size() )
+			seps.resize( block.size() );
+		auto nbSeps = scanSeparators( block.data(), block.size(), params.delimiter_in, seps.data() );
+
+		size_t lineStart = 0;
+		size_t nbDelims  = 0;
+		for( size_t k=0; k<=nbSeps; k++ )
+		{
+			size_t sep = ( k < nbSeps ? seps[k] : block.size() );
+			if( k < nbSeps && block[sep] != '\n' )
+			{
+				if( nbDelims < delims.size() )
+					delims[nbDelims] = static_cast<uint32_t>( sep - lineStart );
+				nbDelims++;
+				continue;
+			}
+			if( k == nbSeps && lineStart == block.size() )     // block ends with a newline
+				break;
+			processLine( block.substr( lineStart, sep-lineStart ), nbDelims );
+			lineStart = sep+1;
+			nbDelims  = 0;
+		}
+	}
+}
+//-------------------------------------------------------------------
+/// Parses the input data held in \c buffer and calls \c onEvent for every event found
+/**
+Lines are split on newline characters and handed as views on the buffer, see parseLines().
+The column layout is compiled once into a ColumnPlan, and only the needed columns are extracted from each line.
+The most frequent layouts (see DefaultColumnPlan and AdeColumnPlan) have a specialized version,
+where the column indexes are compile-time constants.
 
-	results.writeCsv( "adepopro_E_", results._instructorData, head1 + "nb modules"    , params );
-	results.writeCsv( "adepopro_M_", results._moduleData,     head1 + "nb enseignants", params );
-	results.writeReport_MI( "adepopro_ME_", params );
-	results.writeReport_IM( "adepopro_EM_", params );
+\c onEvent is called with the same arguments as Data::addOne(), see readData().
+The line counts are added to \c counts if not null.
+*/
+template<typename FUNC>
+void
+parseData( std::string_view buffer, const Params& params, FUNC&& onEvent, ReadStats* counts=nullptr )
+{
+	ReadStats nb;
+	ColumnPlan plan( params );
+	if( DefaultColumnPlan::matches( plan ) )
+		parseLines( buffer, params, DefaultColumnPlan(), onEvent, nb );
+	else if( AdeColumnPlan::matches( plan ) )
+		parseLines( buffer, params, AdeColumnPlan(), onEvent, nb );
+	else
+		parseLines( buffer, params, plan, onEvent, nb );
 
+	if( counts )
+		*counts += nb;
+}
+//-------------------------------------------------------------------
+/// Parses the input data held in \c buffer and adds every event found to \c results
+/**
+If \c stats is not null, the line counts and the time spent in parsing and in Data::addOne() are added to it.
+The timing is done in a separate loop, so it has no cost when not requested.
+*/
+void
+readData( std::string_view buffer, const Params& params, Data& results, ReadStats* stats=nullptr )
+{
+	if( stats )
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::duration addOneTime{};
+		parseData(
+			buffer,
+			params,
+			[&results,&addOneTime]     // lambda
+			( std::string_view instr, size_t num_sem, EN_WeekDay wd, const std::pair<EN_CourseType,std::string_view>& type_mod, float duration )
+			{
+				auto t0 = std::chrono::steady_clock::now();
+				results.addOne( instr, num_sem, wd, type_mod, duration );
+				addOneTime += std::chrono::steady_clock::now() - t0;
+			},
+			stats
+		);
+		stats->addOneTime += toSeconds( addOneTime );
+		stats->parseTime  += toSeconds( std::chrono::steady_clock::now() - start - addOneTime );
+		return;
+	}
+	parseData(
+		buffer,
+		params,
+		[&results]                 // lambda
+		( std::string_view instr, size_t num_sem, EN_WeekDay wd, const std::pair<EN_CourseType,std::string_view>& type_mod, float duration )
+		{
+			results.addOne( instr, num_sem, wd, type_mod, duration );
+		}
+	);
+}
+
+//-------------------------------------------------------------------
+/// Splits \c buffer into (at most) \c nb ranges of similar size, each one starting at the beginning of a line
+std::vector<std::string_view>
+splitLineAligned( std::string_view buffer, size_t nb )
+{
+	std::vector<std::string_view> ranges;
+	size_t start = 0;
+	for( size_t i=1; i<=nb && start<buffer.size(); i++ )
+	{
+		size_t end = buffer.size();
+		if( i < nb )
+		{
+			end = std::max( start, buffer.size() * i / nb );
+			end = buffer.find( '\n', end );
+			end = ( end == std::string_view::npos ? buffer.size() : end+1 );
+		}
+		ranges.push_back( buffer.substr( start, end-start ) );
+		start = end;
+	}
+	return ranges;
+}
+//-------------------------------------------------------------------
+/// Multi-threaded version of readData()
+/**
+The buffer is split into line-aligned ranges, each one is parsed by a thread into its own Data shard.
+The shards are then merged in file order, so the result does not depend on thread scheduling.
+
+If an error occurs, the exception thrown on the first faulty range is rethrown.
+*/
+void
+readData_mt( std::string_view buffer, const Params& params, Data& results, size_t nbThreads, ReadStats* stats=nullptr )
+{
+	if( nbThreads < 2 )
+	{
+		readData( buffer, params, results, stats );
+		return;
+	}
+	auto ranges = splitLineAligned( buffer, nbThreads );
+	std::vector<Data>               shards( ranges.size() );
+	for( auto& shard: shards )
+		shard.selectLike( results );
+	std::vector<ReadStats>          shardStats( stats ? ranges.size() : 0 );
+	std::vector<std::exception_ptr> errors( ranges.size() );
+	std::vector<std::thread>        threads;
+	for( size_t i=0; i<ranges.size(); i++ )
+		threads.emplace_back(
+			[&,i]()                    // lambda
+			{
+				try
+				{
+					readData( ranges[i], params, shards[i], stats ? &shardStats[i] : nullptr );
+				}
+				catch( ... )
+				{
+					errors[i] = std::current_exception();
+				}
+			}
+		);
+	for( auto& th: threads )
+		th.join();
+
+	for( const auto& err: errors )
+		if( err )
+			std::rethrow_exception( err );
+
+	auto start = std::chrono::steady_clock::now();
+	for( const auto& shard: shards )
+		results.merge( shard );
+	if( stats )
+	{
+		for( const auto& st: shardStats )
+			*stats += st;
+		stats->mergeTime += toSeconds( std::chrono::steady_clock::now() - start );
+	}
+}
+
+//-------------------------------------------------------------------
+/// Identifies the part of the input a snapshot has been built from
+/**
+The snapshot only holds the content of the input file up to the end of its last complete line.
+As long as this part of the file is unchanged, the snapshot can be used, even if some lines have been appended.
+*/
+struct SnapshotKey
+{
+	uint64_t inputSize  = 0;   ///< size of the part of the input file that has been processed
+	uint64_t inputHash  = 0;   ///< hash of that part, see hashBytes()
+	uint64_t paramsHash = 0;   ///< hash of the parameters used for reading, see Params::inputSignature()
+};
+
+/// Header of a snapshot file, followed by the payload written by Data::save()
+struct SnapshotHeader
+{
+	char        magic[8];
+	uint32_t    version;
+	uint32_t    headerSize;
+	SnapshotKey key;
+	uint64_t    content;       ///< what the payload holds, see EN_SnapshotContent
+	uint64_t    payloadSize;
+	uint64_t    payloadHash;
+};
+
+const char     g_snapMagic[8] = { 'A','D','E','P','O','S','N','P' };
+/// To be incremented each time the content of Data::save() changes
+const uint32_t g_snapVersion  = 6;
+
+//-------------------------------------------------------------------
+/// Returns the size of the part of \c content that holds complete lines (that is, up to the last newline character)
+size_t
+completeLinesSize( std::string_view content )
+{
+	auto pos = content.rfind( '\n' );
+	return pos == std::string_view::npos ? 0 : pos+1;
+}
+//-------------------------------------------------------------------
+/// Loads \c data from the snapshot file \c fn
+/**
+Returns the size of the part of \c content that is already held in the snapshot, so only the remaining part needs to be read.
+Returns 0 if there is no such file, or if it has not been built from the same input
+(or from an input that does not start with the same lines), or by another version, or if it is corrupted,
+or if it does not hold everything \c data needs (see Data::snapshotContent()).
+*/
+size_t
+loadSnapshot( std::string fn, std::string_view content, const Params& params, Data& data )
+{
+	if( !std::filesystem::exists( fn ) )
+		return 0;
+	try
+	{
+		MappedFile file( fn );
+		auto buf = file.view();
+		SnapshotHeader head;
+		if( buf.size() < sizeof(head) )
+			return 0;
+		std::memcpy( &head, buf.data(), sizeof(head) );
+		if( std::memcmp( head.magic, g_snapMagic, sizeof(g_snapMagic) ) != 0
+			|| head.version        != g_snapVersion
+			|| head.headerSize     != sizeof(head)
+			|| head.key.paramsHash != hashBytes( params.inputSignature() )
+			|| head.key.inputSize  >  content.size()
+			|| head.key.inputHash  != hashBytes( content.substr( 0, head.key.inputSize ) )
+			|| ( head.content & data.snapshotContent() ) != data.snapshotContent()
+			|| head.payloadSize    != buf.size() - sizeof(head) )
+			return 0;
+		auto payload = buf.substr( sizeof(head) );
+		if( hashBytes( payload ) != head.payloadHash )
+			return 0;
+		SnapshotReader snap( payload );
+		data.load( snap, head.content );
+		return head.key.inputSize;
+	}
+	catch( const std::exception& e )
+	{
+		std::cerr << "Warning, unable to read snapshot " << fn << ": " << e.what() << '\n';
+		data.clear();
+	}
+	return 0;
+}
+//-------------------------------------------------------------------
+/// Saves \c data, that holds the events of \c content, into the snapshot file \c fn
+/**
+The file is first written under a temporary name, then renamed, so that a snapshot
+is never seen half-written. Failing to write it is not an error, the program just goes on.
+*/
+void
+saveSnapshot( std::string fn, std::string_view content, const Params& params, const Data& data )
+{
+	SnapshotWriter snap;
+	data.save( snap );
+
+	static_assert( std::has_unique_object_representations<SnapshotHeader>::value, "snapshot header must not have padding bytes" );
+	SnapshotHeader head = {};
+	std::memcpy( head.magic, g_snapMagic, sizeof(g_snapMagic) );
+	head.version        = g_snapVersion;
+	head.headerSize     = sizeof(head);
+	head.key.inputSize  = content.size();
+	head.key.inputHash  = hashBytes( content );
+	head.key.paramsHash = hashBytes( params.inputSignature() );
+	head.content        = data.snapshotContent();
+	head.payloadSize    = snap.buffer().size();
+	head.payloadHash    = hashBytes( snap.buffer() );
+
+	auto fn_tmp = fn + ".tmp";
+	{
+		std::ofstream file( fn_tmp, std::ios::binary );
+		file.write( reinterpret_cast<const char*>( &head ), sizeof(head) );
+		file.write( snap.buffer().data(), snap.buffer().size() );
+		if( !file )
+		{
+			std::cerr << "Warning, unable to write snapshot " << fn << '\n';
+			return;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename( fn_tmp, fn, ec );
+	if( ec )
+		std::cerr << "Warning, unable to write snapshot " << fn << ": " << ec.message() << '\n';
+}
+//-------------------------------------------------------------------
+/// An event with its time slot and room, see readBookings()
+struct Booking
+{
+	static constexpr uint32_t None = std::numeric_limits<uint32_t>::max();   ///< no instructor or no room
+
+	uint32_t         _instructor;   ///< ID in the instructor interner given to readBookings(), or None
+	uint32_t         _room;         ///< ID in the room interner, or None
+	uint32_t         _week;
+	EN_WeekDay       _day;
+	int              _start;        ///< in minutes since midnight
+	int              _end;
+	uint32_t         _lineNum;      ///< line number in the input file, starting at 1
+	std::string_view _line;         ///< view on the input buffer
+};
+//-------------------------------------------------------------------
+/// Reads from \c buffer all the events with their time slot and room
+/**
+Uses the optional columns (see ColIndex), so this is a separate pass over the input data, done only when needed.
+Lines are skipped following the same rules as parseData(), and if a week range is given, only its events are kept.
+The event with no instructor or no room get Booking::None.
+*/
+std::vector<Booking>
+readBookings( std::string_view buffer, const Params& params, StringInterner& instructors, StringInterner& rooms )
+{
+	size_t highestIndex = 0;
+	for( const auto& ci: params.colIndex )
+		highestIndex = std::max( highestIndex, static_cast<size_t>( ci.second ) );
+
+	std::vector<Booking> out;
+	std::vector<std::string_view> v_str;
+	uint32_t lineNum = 0;
+	size_t pos = 0;
+	while( pos < buffer.size() )
+	{
+		auto eol = buffer.find( '\n', pos );
+		if( eol == std::string_view::npos )
+			eol = buffer.size();
+		auto line = buffer.substr( pos, eol-pos );
+		pos = eol+1;
+		lineNum++;
+		if( line.empty() || line.front() == params.delimiter_in || line.front() == params.commentChar )
+			continue;
+
+		split_view( line, params.delimiter_in, v_str, highestIndex+1 );
+		if( v_str.size() <= highestIndex )
+			throw std::runtime_error( "Error, line " + std::to_string(lineNum) + " has less than " + std::to_string(highestIndex+1) + " fields" );
+		if( v_str[ params.colIndex.at(CI_Module) ].empty() )
+			continue;
+
+		Booking bk;
+		bk._week = getWeekNum( v_str[ params.colIndex.at(CI_Week) ] );
+		if( bk._week >= Presence::NbWeeks )       // same limit as Data::addOne(), the room report uses one bit per week
+		{
+			std::cerr << "Warning, line " << lineNum << " skipped: week number must be lower than " << Presence::NbWeeks << ", read: " << bk._week << '\n';
+			continue;
+		}
+		if( params.weekRange && ( bk._week < params.weekFirst || bk._week > params.weekLast ) )
+			continue;
+		bk._day     = getWeekDay(   v_str[ params.colIndex.at(CI_Day)   ] );
+		bk._start   = getTimeOfDay( v_str[ params.colIndex.at(CI_Start) ] );
+		bk._end     = getTimeOfDay( v_str[ params.colIndex.at(CI_End)   ] );
+		bk._lineNum = lineNum;
+		bk._line    = line;
+		auto instr = v_str[ params.colIndex.at(CI_Instructor) ];
+		auto room  = v_str[ params.colIndex.at(CI_Room) ];
+		bk._instructor = instr.empty() ? Booking::None : instructors.intern( instr );
+		bk._room       = room.empty()  ? Booking::None : rooms.intern( room );
+		out.push_back( bk );
+	}
+	return out;
+}
+//-------------------------------------------------------------------
+/// Calls \c onConflict with the indexes of each pair of overlapping bookings of a same resource (instructor if \c byRoom is false, else room)
+/**
+The bookings are sorted by (resource, week, day, start), then each (resource, day) sequence is swept:
+the bookings that are still running when a new one starts are kept in an "active" list, and overlap the new one.
+So this is O(n log n), plus the number of conflicts, which are handed one at a time so they need no storage.
+
+The resources are ordered by name, so the conflicts come out sorted by resource, week, day and start time.
+*/
+template<typename FUNC>
+void
+findConflicts( const std::vector<Booking>& bookings, bool byRoom, const StringInterner& names, FUNC&& onConflict )
+{
+	std::vector<uint32_t> rank( names.size() );
+	auto order = names.sortedIds();
+	for( size_t i=0; i<order.size(); i++ )
+		rank[order[i]] = static_cast<uint32_t>( i );
+	auto resOf = [byRoom]( const Booking& bk ) { return byRoom ? bk._room : bk._instructor; };
+
+	std::vector<uint32_t> idx;
+	for( uint32_t i=0; i<bookings.size(); i++ )
+		if( resOf( bookings[i] ) != Booking::None )
+			idx.push_back( i );
+	std::sort(
+		std::begin(idx),
+		std::end(idx),
+		[&]                        // lambda
+		( uint32_t i1, uint32_t i2 )
+		{
+			const auto& b1 = bookings[i1];
+			const auto& b2 = bookings[i2];
+			return std::make_tuple( rank[resOf(b1)], b1._week, b1._day, b1._start, b1._end, b1._lineNum )
+				<  std::make_tuple( rank[resOf(b2)], b2._week, b2._day, b2._start, b2._end, b2._lineNum );
+		}
+	);
+
+	std::vector<uint32_t> active;             // bookings of the current (resource, day) that may overlap the next ones
+	for( size_t k=0; k<idx.size(); k++ )
+	{
+		const auto& bk = bookings[idx[k]];
+		if( k > 0 )
+		{
+			const auto& prev = bookings[idx[k-1]];
+			if( resOf(prev) != resOf(bk) || prev._week != bk._week || prev._day != bk._day )
+				active.clear();
+		}
+		active.erase(
+			std::remove_if( std::begin(active), std::end(active), [&]( uint32_t a ){ return bookings[a]._end <= bk._start; } ),
+			std::end(active)
+		);
+		for( auto a: active )
+			onConflict( a, idx[k] );
+		active.push_back( idx[k] );
+	}
+}
+//-------------------------------------------------------------------
+/// Writes \c minutes as a time of day "08h30"
+void
+printTimeOfDay( OutBuffer& file, int minutes )
+{
+	auto h  = minutes / 60;
+	auto mn = minutes % 60;
+	file << ( h < 10 ? "0" : "" ) << h << 'h' << ( mn < 10 ? "0" : "" ) << mn;
+}
+//-------------------------------------------------------------------
+/// Writes \c str as a quoted CSV field, so that it can hold the separator character
+void
+printQuoted( OutBuffer& file, std::string_view str )
+{
+	file << '"';
+	for( auto c: str )
+	{
+		if( c == '"' )
+			file << '"';
+		file << c;
+	}
+	file << '"';
+}
+//-------------------------------------------------------------------
+/// Writes \c str as a JSON string: between double quotes, with quotes, backslashes and control characters escaped, see writeStats()
+void
+printJsonString( OutBuffer& file, std::string_view str )
+{
+	const char* hex = "0123456789abcdef";
+	file << '"';
+	for( auto c: str )
+	{
+		if( c == '"' || c == '\\' )
+			file << '\\' << c;
+		else if( static_cast<unsigned char>( c ) < 0x20 )
+			file << "\\u00" << hex[ c >> 4 ] << hex[ c & 0xF ];
+		else
+			file << c;
+	}
+	file << '"';
+}
+//-------------------------------------------------------------------
+/// Writes the conflicts report: each pair of overlapping events of a same instructor or of a same room, with both source lines
+/**
+As there can be many conflicts, the report is handed to \c writer in parts of about 1MB (see OutBuffer::split()).
+*/
+OutBuffer
+writeConflicts( std::string fn, std::string_view buffer, const Params& params, AsyncWriter& writer )
+{
+	StringInterner instructors, rooms;
+	auto bookings = readBookings( buffer, params, instructors, rooms );
+
+	auto file = openFile(
+		fn + params.rootFileName + ".csv",
+		"# Type;Ressource;Semaine;Jour;Ligne 1;Horaire 1;Ligne 2;Horaire 2;Source 1;Source 2",
+		params.inputFileName,
+		params.atomicWrite
+	);
+	for( int byRoom=0; byRoom<2; byRoom++ )
+	{
+		const auto& names = byRoom ? rooms : instructors;
+		findConflicts( bookings, byRoom, names, [&]( uint32_t i1, uint32_t i2 )     // lambda
+		{
+			const auto& b1 = bookings[i1];
+			const auto& b2 = bookings[i2];
+			file << ( byRoom ? "Salle" : "Enseignant" ) << g_ocs << names.name( byRoom ? b1._room : b1._instructor )
+				<< g_ocs << b1._week << g_ocs << g_dayNames[b1._day]
+				<< g_ocs << b1._lineNum << g_ocs;
+			printTimeOfDay( file, b1._start );
+			file << '-';
+			printTimeOfDay( file, b1._end );
+			file << g_ocs << b2._lineNum << g_ocs;
+			printTimeOfDay( file, b2._start );
+			file << '-';
+			printTimeOfDay( file, b2._end );
+			file << g_ocs;
+			printQuoted( file, b1._line );
+			file << g_ocs;
+			printQuoted( file, b2._line );
+			file << '\n';
+			if( file.str().size() > ( 1 << 20 ) )
+				writer.push( file.split() );
+		} );
+	}
+	return file;
+}
+//-------------------------------------------------------------------
+/// Duration of the time slots of the room report, in minutes
+const int g_slotMinutes = 15;
+/// Number of time slots in a day
+const int g_nbDaySlots  = 24*60 / g_slotMinutes;
+
+/// Occupancy of a room over a day, one bit per time slot
+typedef std::array<uint64_t,( g_nbDaySlots+63 )/64> DaySlots;
+
+/// Returns the slots \c first (included) to \c last (excluded)
+DaySlots
+slotMask( int first, int last )
+{
+	DaySlots mask = {};
+	for( int sl=std::max( first, 0 ); sl<std::min( last, g_nbDaySlots ); sl++ )
+		mask[sl/64] |= uint64_t(1) << (sl%64);
+	return mask;
+}
+
+size_t
+popCount( const DaySlots& ds )
+{
+	size_t nb = 0;
+	for( auto v: ds )
+		nb += popCount( v );
+	return nb;
+}
+//-------------------------------------------------------------------
+/// Occupancy of a room: one DaySlots per (week, day)
+struct RoomSlots
+{
+	std::array<DaySlots,Presence::NbWeeks*5> _slots = {};
+
+	DaySlots& at( size_t week, size_t wd )
+	{
+		return _slots[ week*5 + wd ];
+	}
+	const DaySlots& at( size_t week, size_t wd ) const
+	{
+		return _slots[ week*5 + wd ];
+	}
+};
+//-------------------------------------------------------------------
+/// Writes the room occupancy report
+/**
+Each event sets the quarter-hour slots it covers in the bitmap of its room, week and day (see RoomSlots),
+so overlapping events are counted once, and everything is then computed with OR and popcount:
+ - occupancy rate of each week: occupied slots between opening and closing time (see Params::roomOpening),
+ over the available slots of the 5 days,
+ - average rate over the weeks of the input file,
+ - peak hour: the slot that is occupied the most often,
+ - weekdays on which the room is never used.
+*/
+OutBuffer
+writeRooms( std::string fn, std::string_view buffer, const Params& params )
+{
+	StringInterner instructors, rooms;
+	auto bookings = readBookings( buffer, params, instructors, rooms );
+
+	std::vector<RoomSlots> v_slots( rooms.size() );
+	uint64_t weeks = 0;
+	for( const auto& bk: bookings )
+		if( bk._room != Booking::None )
+		{
+			auto mask = slotMask( bk._start / g_slotMinutes, ( bk._end + g_slotMinutes-1 ) / g_slotMinutes );
+			auto& ds  = v_slots[bk._room].at( bk._week, bk._day );
+			for( size_t i=0; i<ds.size(); i++ )
+				ds[i] |= mask[i];
+			weeks |= uint64_t(1) << bk._week;
+		}
+
+	auto open    = slotMask( params.roomOpening / g_slotMinutes, ( params.roomClosing + g_slotMinutes-1 ) / g_slotMinutes );
+	auto nbOpen  = popCount( open ) * 5;
+	std::vector<size_t> v_weeks;
+	for( size_t w=0; w<Presence::NbWeeks; w++ )
+		if( weeks & ( uint64_t(1) << w ) )
+			v_weeks.push_back( w );
+
+	std::string headline = "# Salle;Taux moyen (%);Heure de pointe;Jours inutilises";
+	for( auto w: v_weeks )
+		headline += ";S" + std::to_string( w );
+	auto file = openFile( fn + params.rootFileName + ".csv", headline, params.inputFileName, params.atomicWrite );
+
+	for( auto id: rooms.sortedIds() )
+	{
+		const auto& rs = v_slots[id];
+		std::array<DaySlots,5>            usedDay = {};
+		std::array<size_t,g_nbDaySlots>   perSlot = {};
+		std::vector<size_t>               occupied;
+		size_t total = 0;
+		for( auto w: v_weeks )
+		{
+			size_t occ = 0;
+			for( size_t d=0; d<5; d++ )
+			{
+				const auto& ds = rs.at( w, d );
+				for( size_t i=0; i<ds.size(); i++ )
+				{
+					usedDay[d][i] |= ds[i];
+					occ += popCount( ds[i] & open[i] );
+					for( auto bits = ds[i]; bits; bits &= bits-1 )
+						perSlot[ i*64 + popCount( ( bits & (~bits+1) ) - 1 ) ]++;
+				}
+			}
+			occupied.push_back( occ );
+			total += occ;
+		}
+		file << rooms.name( id ) << g_ocs;
+		file.printFixed( 100. * total / ( nbOpen * v_weeks.size() ), 0, 1 );
+		file << g_ocs;
+		auto peak = std::max_element( std::begin(perSlot), std::end(perSlot) );
+		if( *peak == 0 )
+			file << '-';
+		else
+			printTimeOfDay( file, static_cast<int>( peak - std::begin(perSlot) ) * g_slotMinutes );
+		file << g_ocs;
+		bool first = true;
+		for( size_t d=0; d<5; d++ )
+			if( popCount( usedDay[d] ) == 0 )
+			{
+				file << ( first ? "" : " " ) << g_dayNames[d];
+				first = false;
+			}
+		for( auto occ: occupied )
+		{
+			file << g_ocs;
+			file.printFixed( 100. * occ / nbOpen, 0, 1 );
+		}
+		file << '\n';
+	}
+	return file;
+}
+//-------------------------------------------------------------------
+/// Statistics on the processing of an input file, written when option "--stats" is given (see writeStats())
+struct RunStats
+{
+	std::vector<std::pair<std::string,double>> _phases;   ///< wall time of each phase (seconds), in execution order
+	ReadStats _read;
+	size_t    _inputSize  = 0;   ///< size of the input file
+	size_t    _parsedSize = 0;   ///< bytes actually parsed, lower than the input size when the snapshot has been used
+	double    _totalTime  = 0.;
+
+/// Adds \c t to the time of phase \c name
+	void addPhase( std::string name, double t )
+	{
+		auto it = std::find_if( std::begin(_phases), std::end(_phases), [&name]( const auto& p ){ return p.first == name; } );
+		if( it == std::end(_phases) )
+			_phases.emplace_back( name, t );
+		else
+			it->second += t;
+	}
+};
+//-------------------------------------------------------------------
+/// Measures the wall time from construction to destruction, and adds it to \c stats as phase \c name. Does nothing if \c stats is null.
+class PhaseTimer
+{
+	public:
+		PhaseTimer( RunStats* stats, const char* name ): _stats(stats), _name(name)
+		{
+			if( _stats )
+				_start = std::chrono::steady_clock::now();
+		}
+		~PhaseTimer()
+		{
+			if( _stats )
+				_stats->addPhase( _name, toSeconds( std::chrono::steady_clock::now() - _start ) );
+		}
+	private:
+		RunStats*   _stats;
+		const char* _name;
+		std::chrono::steady_clock::time_point _start;
+};
+//-------------------------------------------------------------------
+/// Returns the peak resident set size of the process, in kB (0 if unknown)
+size_t
+getPeakRss()
+{
+#ifdef ADEPOPRO_HAS_MMAP
+	struct rusage usage;
+	if( getrusage( RUSAGE_SELF, &usage ) == 0 )
+	#ifdef __APPLE__
+		return usage.ru_maxrss / 1024;      // bytes on macOS
+	#else
+		return usage.ru_maxrss;
+	#endif
+#endif
+	return 0;
+}
+//-------------------------------------------------------------------
+/// Writes the statistics \c stats on the processing of the input file into \c results, as a single JSON object
+/**
+Peak RSS is for the whole process, so in batch mode it covers all the files processed so far.
+*/
+void
+writeStats( std::string fn, const RunStats& stats, const Data& results, const Params& params )
+{
+	fn += params.rootFileName + ".json";
+	std::cout << " - génération du fichier " + fn + '\n';
+	OutBuffer file( fn, params.atomicWrite );
+
+	const auto& rd = stats._read;
+	auto rate = [&stats]( size_t nb ) { return stats._totalTime > 0. ? nb / stats._totalTime : 0.; };
+	auto nbEntries = []( const ResourceVolumeMap& rvm ) { return rvm._colIds.size(); };
+
+	file << "{\n  \"input\": ";
+	printJsonString( file, params.inputFileName );
+	file << ",\n  \"input_bytes\": " << stats._inputSize
+		<< ",\n  \"parsed_bytes\": " << stats._parsedSize
+		<< ",\n  \"total_s\": " << stats._totalTime
+		<< ",\n  \"phases_s\": {";
+	for( size_t i=0; i<stats._phases.size(); i++ )
+		file << ( i ? ", " : " " ) << '"' << stats._phases[i].first << "\": " << stats._phases[i].second;
+	file << " }"
+		<< ",\n  \"read_s\": { \"parse\": " << rd.parseTime << ", \"addOne\": " << rd.addOneTime << ", \"merge\": " << rd.mergeTime << " }"
+		<< ",\n  \"rows_per_s\": " << rate( rd.nbEvents )
+		<< ",\n  \"bytes_per_s\": " << rate( stats._parsedSize )
+		<< ",\n  \"peak_rss_kb\": " << getPeakRss()
+		<< ",\n  \"lines\": { \"events\": " << rd.nbEvents << ", \"comment\": " << rd.nbComments
+			<< ", \"skipped\": " << rd.nbSkipped << ", \"empty_module\": " << rd.nbEmptyModule << ", \"empty\": " << rd.nbEmpty << " }"
+		<< ",\n  \"instructors\": " << results._instructors.size()
+		<< ",\n  \"modules\": " << results._modules.size()
+		<< ",\n  \"pairs\": " << results._volumes.size()
+		<< ",\n  \"mod_prof\": { \"rows\": " << results._mod_prof.nbRows() << ", \"entries\": " << nbEntries( results._mod_prof ) << " }"
+		<< ",\n  \"prof_mod\": { \"rows\": " << results._prof_mod.nbRows() << ", \"entries\": " << nbEntries( results._prof_mod ) << " }"
+		<< ",\n  \"instructor_days\": { \"size\": " << results._instructorDays.size() << ", \"bytes\": " << results._instructorDays.size() * sizeof(Presence) << " }"
+		<< ",\n  \"module_days\": { \"size\": " << results._moduleDays.size() << ", \"bytes\": " << results._moduleDays.size() * sizeof(Presence) << " }"
+		<< "\n}\n";
+	file.close();
+}
+//-------------------------------------------------------------------
+/// Reads the input file content in \c results, using (and updating) the snapshot file if \c useSnapshot is true
+/**
+If a valid snapshot exists, only the lines added after it was written are parsed (incremental mode).
+The last line is kept out of the snapshot if it has no newline character, as it may be incomplete.
+The snapshot always holds all the weeks, the week range of \c params (if any) is applied afterwards,
+then Data::compute() is called.
+
+If \c stats is not null, the time of each phase is added to it.
+*/
+void
+readInput( std::string fn_in, std::string_view content, const Params& params, Data& results, size_t nbThreads, bool useSnapshot, RunStats* stats=nullptr )
+{
+	ReadStats* readStats = stats ? &stats->_read : nullptr;
+	size_t done = 0;
+	if( !useSnapshot )
+	{
+		PhaseTimer timer( stats, "read" );
+		readData_mt( content, params, results, nbThreads, readStats );
+	}
+	else
+	{
+		auto fn_snap = fn_in + ".snap";
+		{
+			PhaseTimer timer( stats, "snapshot_load" );
+			done = loadSnapshot( fn_snap, content, params, results );
+		}
+		auto complete = completeLinesSize( content );
+		if( done )
+			std::cout << " - lecture du cache " << fn_snap << " (" << content.size()-done << " octets nouveaux)\n";
+
+		if( complete > done || !std::filesystem::exists( fn_snap ) )
+		{
+			{
+				PhaseTimer timer( stats, "read" );
+				readData_mt( content.substr( done, complete-done ), params, results, nbThreads, readStats );
+			}
+			{
+				PhaseTimer timer( stats, "compute" );
+				results.computeResources();
+			}
+			PhaseTimer timer( stats, "snapshot_save" );
+			saveSnapshot( fn_snap, content.substr( 0, complete ), params, results );
+		}
+		if( complete < content.size() )
+		{
+			PhaseTimer timer( stats, "read" );
+			readData( content.substr( complete ), params, results, readStats );
+		}
+	}
+	if( params.weekRange )
+	{
+		PhaseTimer timer( stats, "weeks" );
+		results.restrictToWeeks( params.weekFirst, params.weekLast );
+	}
+	PhaseTimer timer( stats, "compute" );
+	results.compute();
+	if( stats )
+		stats->_parsedSize += content.size() - done;
+}
+
+//-------------------------------------------------------------------
+/// A report to write: the name of its phase in RunStats, and the function formatting it, see writeReports()
+/**
+The function may hand parts of a large report to the writer before returning the rest, see writeConflicts().
+*/
+typedef std::pair<const char*,std::function<OutBuffer(AsyncWriter&)>> ReportTask;
+
+/// Formats the reports \c reports concurrently, one thread each, and writes them with an AsyncWriter
+/**
+The time of each report (formatting only) is added to \c stats, the time spent waiting for the files to be written as "write_flush".
+*/
+void
+writeReports( const std::vector<ReportTask>& reports, RunStats* stats )
+{
+	AsyncWriter              writer;
+	std::vector<double>      v_time( reports.size() );
+	std::vector<std::string> v_err( reports.size() );
+	std::vector<std::thread> pool;
+	for( size_t i=0; i<reports.size(); i++ )
+		pool.emplace_back(
+			[&,i]()                      // lambda
+			{
+				try
+				{
+					auto start = std::chrono::steady_clock::now();
+					auto file  = reports[i].second( writer );
+					v_time[i]  = toSeconds( std::chrono::steady_clock::now() - start );
+					writer.push( std::move( file ) );
+				}
+				catch( const std::exception& e )
+				{
+					v_err[i] = e.what();
+				}
+			}
+		);
+	for( auto& th: pool )
+		th.join();
+	for( const auto& err: v_err )
+		if( !err.empty() )
+			throw std::runtime_error( err );
+
+	if( stats )
+		for( size_t i=0; i<reports.size(); i++ )
+			stats->addPhase( reports[i].first, v_time[i] );
+	PhaseTimer timer( stats, "write_flush" );
+	writer.finish();
+}
+//-------------------------------------------------------------------
+/// Reads input file \c fn_in and writes the four output files, plus the statistics file if \c withStats is true
+Data
+processFile( std::string fn_in, Params params, size_t nbThreads, bool useSnapshot, bool withStats=false )
+{
+	RunStats  runStats;
+	RunStats* stats = withStats ? &runStats : nullptr;
+	auto start = std::chrono::steady_clock::now();
+
+	std::unique_ptr<MappedFile> file;
+	{
+		PhaseTimer timer( stats, "map" );
+		file.reset( new MappedFile( fn_in ) );
+	}
+	Data results;
+	results.select( params.reports, params.weekRange );
+	readInput( fn_in, file->view(), params, results, nbThreads, useSnapshot, stats );
+	params.assignFileName( fn_in );
+
+// csv output file headers
+	std::string head1 = "# Nom;Nb jours;Nb sem;vol. CM;vol. TD;vol. TP;vol. total;";
+	auto content = file->view();
+	std::vector<ReportTask> reports;
+	if( params.reports & RP_E )
+		reports.emplace_back( "write_E",  [&]( AsyncWriter& ){ return results.writeCsv( "adepopro_E_", results._instructorData, results._instructors, head1 + "nb modules"    , params ); } );
+	if( params.reports & RP_M )
+		reports.emplace_back( "write_M",  [&]( AsyncWriter& ){ return results.writeCsv( "adepopro_M_", results._moduleData,     results._modules,     head1 + "nb enseignants", params ); } );
+	if( params.reports & RP_ME )
+		reports.emplace_back( "write_ME", [&]( AsyncWriter& ){ return results.writeReport_MI( "adepopro_ME_", params ); } );
+	if( params.reports & RP_EM )
+		reports.emplace_back( "write_EM", [&]( AsyncWriter& ){ return results.writeReport_IM( "adepopro_EM_", params ); } );
+	if( params.reports & RP_EW )
+		reports.emplace_back( "write_EW", [&]( AsyncWriter& ){ return results.writeWeekly( "adepopro_EW_", results._instructorWeeks, results._instructors, params ); } );
+	if( params.reports & RP_MW )
+		reports.emplace_back( "write_MW", [&]( AsyncWriter& ){ return results.writeWeekly( "adepopro_MW_", results._moduleWeeks, results._modules, params ); } );
+	if( params.conflicts )
+		reports.emplace_back( "write_C", [&]( AsyncWriter& writer ){ return writeConflicts( "adepopro_C_", content, params, writer ); } );
+	if( params.roomReport )
+		reports.emplace_back( "write_R", [&]( AsyncWriter& ){ return writeRooms( "adepopro_R_", content, params ); } );
+	writeReports( reports, stats );
+	if( stats )
+	{
+		stats->_inputSize = file->view().size();
+		stats->_totalTime = toSeconds( std::chrono::steady_clock::now() - start );
+		writeStats( "adepopro_stats_", *stats, results, params );
+	}
+	return results;
+}
+//-------------------------------------------------------------------
+/// Data of an instructor over several input files, see writeCombined()
+struct CombinedData
+{
+	Presence    _presence;
+	Triplet     _volume;
+	std::string _files;   ///< list of the input files where the instructor appears
+	size_t      _nbFiles = 0;
+};
+//-------------------------------------------------------------------
+/// Adds the instructors of \c data, read from \c fn_in, to \c combined
+void
+addCombined( std::map<std::string,CombinedData>& combined, const Data& data, std::string fn_in )
+{
+	for( uint32_t id=0; id<data._instructors.size(); id++ )
+	{
+		if( data._instructorData[id]._nbDays == 0 )     // no event in the selected weeks
+			continue;
+		auto& comb = combined[ std::string( data._instructors.name(id) ) ];
+		comb._presence |= data._instructorDays[id];
+		comb._volume   += data._instructorData[id]._volume;
+		comb._files    += ( comb._nbFiles ? " " : "" ) + fn_in;
+		comb._nbFiles++;
+	}
+}
+//-------------------------------------------------------------------
+/// Writes the cross-file instructor data
+/**
+Days and weeks are counted over all the files (so a day where an instructor teaches in two departments counts once),
+this assumes that all the files use the same week numbering.
+*/
+void
+writeCombined( std::string fn, const std::map<std::string,CombinedData>& combined, const Params& params )
+{
+	auto file = openFile( fn, "# Nom;Nb fichiers;Nb jours;Nb sem;vol. CM;vol. TD;vol. TP;vol. total;fichiers", "(batch)", params.atomicWrite );
+	for( const auto& elem: combined )
+	{
+		const auto& comb = elem.second;
+		file << elem.first << g_ocs << comb._nbFiles
+			<< g_ocs << comb._presence.nbDays() << g_ocs << comb._presence.nbWeeks()
+			<< g_ocs << comb._volume << g_ocs << comb._files << '\n';
+	}
+	file.close();
+}
+//-------------------------------------------------------------------
+/// Returns the list of input files: the arguments that are files, plus the .csv files inside the arguments that are folders
+std::vector<std::string>
+listInputFiles( const std::vector<std::string>& args )
+{
+	std::vector<std::string> out;
+	for( const auto& arg: args )
+	{
+		if( !std::filesystem::is_directory( arg ) )
+		{
+			out.push_back( arg );
+			continue;
+		}
+		std::vector<std::string> v_fn;
+		for( const auto& entry: std::filesystem::directory_iterator( arg ) )
+			if( entry.is_regular_file() && entry.path().extension() == ".csv" )
+				v_fn.push_back( entry.path().string() );
+		std::sort( std::begin(v_fn), std::end(v_fn) );
+		out.insert( std::end(out), std::begin(v_fn), std::end(v_fn) );
+	}
+	return out;
+}
+//-------------------------------------------------------------------
+/// Returns the prefix of the output file names of each file of \c v_fn, see Params::rootPrefix
+/**
+As all the output files are written in the current folder, the files that have the same name
+(for example "d1/a.csv" and "d2/a.csv") get their folder as prefix ("d1_a", "d2_a").
+Throws if two files still give the same output names, for example when a file is given twice.
+*/
+std::vector<std::string>
+batchRootPrefixes( const std::vector<std::string>& v_fn )
+{
+	auto rootName = []( const std::filesystem::path& path )    // lambda, same as Params::assignFileName()
+	{
+		auto fn = path.filename().string();
+		return fn.substr( 0, fn.find( '.' ) );
+	};
+	std::map<std::string,size_t> nbSameName;
+	for( const auto& fn: v_fn )
+		nbSameName[ rootName( fn ) ]++;
+
+	std::vector<std::string>           v_prefix( v_fn.size() );
+	std::map<std::string,std::string>  used;     // output name => input file
+	for( size_t idx=0; idx<v_fn.size(); idx++ )
+	{
+		std::filesystem::path path( v_fn[idx] );
+		if( nbSameName[ rootName( path ) ] > 1 )
+			for( const auto& part: path.parent_path().relative_path() )
+				if( part != "." )
+					v_prefix[idx] += part.string() + '_';
+		auto res = used.emplace( v_prefix[idx] + rootName( path ), v_fn[idx] );
+		if( !res.second )
+			throw std::runtime_error( "Error, files " + res.first->second + " and " + v_fn[idx] + " would give the same output files" );
+	}
+	return v_prefix;
+}
+//-------------------------------------------------------------------
+/// Processes all the files in \c v_fn, using a pool of \c nbJobs threads
+/**
+An error on a file does not stop the processing of the others.
+Returns the number of files that could not be processed.
+The output files of files having the same name are prefixed by their folder, see batchRootPrefixes().
+*/
+size_t
+processBatch( const std::vector<std::string>& v_fn, Params params, size_t nbJobs, bool useSnapshot, bool combined, bool withStats )
+{
+	if( combined )                            // the combined file is built from the instructor data
+		params.reports |= RP_E;
+	auto                     v_prefix = batchRootPrefixes( v_fn );
+	std::vector<Data>        v_data( combined ? v_fn.size() : 0 );
+	std::vector<std::string> v_err( v_fn.size() );
+	std::atomic<size_t>      next( 0 );
+	std::vector<std::thread> pool;
+	for( size_t i=0; i<std::min( nbJobs, v_fn.size() ); i++ )
+		pool.emplace_back(
+			[&]()                      // lambda
+			{
+				for( size_t idx = next++; idx < v_fn.size(); idx = next++ )
+				{
+					try
+					{
+						auto fileParams = params;
+						fileParams.rootPrefix = v_prefix[idx];
+						auto data = processFile( v_fn[idx], fileParams, 1, useSnapshot, withStats );
+						if( combined )
+							v_data[idx] = std::move( data );
+					}
+					catch( const std::exception& e )
+					{
+						v_err[idx] = e.what();
+					}
+				}
+			}
+		);
+	for( auto& th: pool )
+		th.join();
+
+	size_t nbErrors = 0;
+	std::map<std::string,CombinedData> comb;
+	for( size_t idx=0; idx<v_fn.size(); idx++ )
+	{
+		if( !v_err[idx].empty() )
+		{
+			std::cerr << "Error on file " << v_fn[idx] << ": " << v_err[idx] << '\n';
+			nbErrors++;
+		}
+		else if( combined )
+			addCombined( comb, v_data[idx], v_fn[idx] );
+	}
+	if( combined )
+		writeCombined( "adepopro_EX_batch.csv", comb, params );
+	return nbErrors;
+}
+//-------------------------------------------------------------------
+/// Writes the resource names of the row \c row of \c rvm, separated by commas
+void
+printNames( OutBuffer& file, const ResourceVolumeMap& rvm, size_t row, const StringInterner& names )
+{
+	for( auto k=rvm._rowStart[row]; k<rvm._rowStart[row+1]; k++ )
+		file << ( k == rvm._rowStart[row] ? "" : "," ) << names.name( rvm._colIds[k] );
+}
+//-------------------------------------------------------------------
+/// Writes in \c file the instructors (or modules, if \c byModule is true) that differ between \c before and \c after, returns their number
+/**
+The rows of the matrices are sorted by name, and so are the entries of each row (see buildVolumeMatrix()),
+so the resources, then the modules of each instructor (resp. instructors of each module),
+are matched with a single merge of the two sorted lists.
+A resource is written if its days, its volume or its set of modules (resp. instructors) have changed.
+*/
+size_t
+diffResources( OutBuffer& file, const Data& before, const Data& after, bool byModule )
+{
+	const auto& rvm1   = byModule ? before._mod_prof : before._prof_mod;
+	const auto& rvm2   = byModule ? after._mod_prof  : after._prof_mod;
+	const auto& names1 = byModule ? before._modules  : before._instructors;
+	const auto& names2 = byModule ? after._modules   : after._instructors;
+	const auto& cols1  = byModule ? before._instructors : before._modules;
+	const auto& cols2  = byModule ? after._instructors  : after._modules;
+	const auto& data1  = byModule ? before._moduleData  : before._instructorData;
+	const auto& data2  = byModule ? after._moduleData   : after._instructorData;
+	const auto& days1  = byModule ? before._moduleDays  : before._instructorDays;
+	const auto& days2  = byModule ? after._moduleDays   : after._instructorDays;
+	const char* type   = byModule ? "M" : "E";
+
+	size_t nbChanged = 0;
+	size_t r1 = 0, r2 = 0;
+	while( r1 < rvm1.nbRows() || r2 < rvm2.nbRows() )
+	{
+		int cmp = ( r1 == rvm1.nbRows() ? 1 : ( r2 == rvm2.nbRows() ? -1 :
+			names1.name( rvm1._rowIds[r1] ).compare( names2.name( rvm2._rowIds[r2] ) ) ) );
+		if( cmp < 0 )                  // removed resource
+		{
+			auto id = rvm1._rowIds[r1];
+			file << type << g_ocs << names1.name(id) << g_ocs << "suppression" << g_ocs << data1[id] << g_ocs << ResourceData() << g_ocs << g_ocs;
+			printNames( file, rvm1, r1++, cols1 );
+			file << '\n';
+			nbChanged++;
+			continue;
+		}
+		if( cmp > 0 )                  // new resource
+		{
+			auto id = rvm2._rowIds[r2];
+			file << type << g_ocs << names2.name(id) << g_ocs << "ajout" << g_ocs << ResourceData() << g_ocs << data2[id] << g_ocs;
+			printNames( file, rvm2, r2++, cols2 );
+			file << g_ocs << '\n';
+			nbChanged++;
+			continue;
+		}
+
+		auto id1 = rvm1._rowIds[r1];
+		auto id2 = rvm2._rowIds[r2];
+		OutBuffer added, removed;
+		auto k1 = rvm1._rowStart[r1], k2 = rvm2._rowStart[r2];
+		while( k1 < rvm1._rowStart[r1+1] || k2 < rvm2._rowStart[r2+1] )
+		{
+			int c = ( k1 == rvm1._rowStart[r1+1] ? 1 : ( k2 == rvm2._rowStart[r2+1] ? -1 :
+				cols1.name( rvm1._colIds[k1] ).compare( cols2.name( rvm2._colIds[k2] ) ) ) );
+			if( c < 0 )
+				removed << ( removed.str().empty() ? "" : "," ) << cols1.name( rvm1._colIds[k1++] );
+			else if( c > 0 )
+				added << ( added.str().empty() ? "" : "," ) << cols2.name( rvm2._colIds[k2++] );
+			else
+			{
+				k1++;
+				k2++;
+			}
+		}
+		std::string changes;
+		if( !( days1[id1] == days2[id2] ) )
+			changes += " jours";
+		if( data1[id1]._volume != data2[id2]._volume )
+			changes += " volume";
+		if( !added.str().empty() || !removed.str().empty() )
+			changes += byModule ? " enseignants" : " modules";
+		if( !changes.empty() )
+		{
+			file << type << g_ocs << names1.name(id1) << g_ocs << changes.substr( 1 ) << g_ocs << data1[id1] << g_ocs << data2[id2]
+				<< g_ocs << added.str() << g_ocs << removed.str() << '\n';
+			nbChanged++;
+		}
+		r1++;
+		r2++;
+	}
+	return nbChanged;
+}
+//-------------------------------------------------------------------
+/// Reads the two input files \c fn_before and \c fn_after concurrently and writes the instructors and modules that differ
+/**
+Only the resources that have been added, removed, or whose days, volume or set of modules (resp. instructors) have changed
+are written, with their values in both files, see diffResources().
+*/
+void
+processDiff( std::string fn_before, std::string fn_after, Params params, size_t nbThreads, bool useSnapshot )
+{
+	std::array<std::string,2> v_fn = { fn_before, fn_after };
+	std::array<Data,2>        v_data;
+	std::array<std::string,2> v_err;
+	std::vector<std::thread>  pool;
+	for( size_t idx=0; idx<2; idx++ )
+		pool.emplace_back(
+			[&,idx]()                  // lambda
+			{
+				try
+				{
+					MappedFile file( v_fn[idx] );
+					v_data[idx].select( RP_E | RP_M | RP_ME | RP_EM, params.weekRange );
+					readInput( v_fn[idx], file.view(), params, v_data[idx], nbThreads, useSnapshot );
+				}
+				catch( const std::exception& e )
+				{
+					v_err[idx] = e.what();
+				}
+			}
+		);
+	for( auto& th: pool )
+		th.join();
+	for( size_t idx=0; idx<2; idx++ )
+		if( !v_err[idx].empty() )
+			throw std::runtime_error( "Error on file " + v_fn[idx] + ": " + v_err[idx] );
+
+	params.assignFileName( fn_after );
+	auto file = openFile(
+		"adepopro_D_" + params.rootFileName + ".csv",
+		"# Type;Nom;Changement;"
+		"Nb jours avant;Nb sem avant;vol. CM avant;vol. TD avant;vol. TP avant;vol. total avant;nb ressources avant;"
+		"Nb jours apres;Nb sem apres;vol. CM apres;vol. TD apres;vol. TP apres;vol. total apres;nb ressources apres;"
+		"ajoutes;retires",
+		fn_before + " -> " + params.inputFileName,
+		params.atomicWrite
+	);
+	auto nbInstructors = diffResources( file, v_data[0], v_data[1], false );
+	auto nbModules     = diffResources( file, v_data[0], v_data[1], true );
+	file.close();
+	std::cout << " - " << nbInstructors << " enseignants et " << nbModules << " modules modifiés\n";
+}
+//-------------------------------------------------------------------
+#ifdef ADEPOPRO_HAS_UNIX_SOCKET
+//-------------------------------------------------------------------
+/// Holds the data of an input file in memory and answers the queries on it, see runServer()
+/**
+Each query is a single line, the answer is either a line "OK n" followed by n lines, or a single line "ERR message".
+Queries:
+ - "E name"  : modules of an instructor, one line per module: "module;CM;TD;TP;total", then "total;CM;TD;TP;total"
+ - "M code"  : instructors of a module, same format
+ - "JE name" : presence of an instructor: "nb days;nb weeks;CM;TD;TP;total;week numbers"
+ - "JM code" : presence of a module, same format
+ - "G"       : total volume of the modules by group (see Params::groupLevels), "group;CM;TD;TP;total",
+ with also the subgroups "group/subgroup;...", "group/subgroup/subsubgroup;..." of the other enabled levels
+ - "LE", "LM": list of the instructors, of the modules
+*/
+class QueryServer
+{
+	public:
+		QueryServer( std::string fn_in, const Params& params, size_t nbThreads, bool useSnapshot )
+			: _fn( fn_in ), _params( params ), _nbThreads( nbThreads ), _useSnapshot( useSnapshot )
+		{
+			load();
+		}
+/// Reloads the input file if it has been modified since it was loaded, keeps the current data if this fails
+		void reloadIfChanged()
+		{
+			std::error_code ec;
+			auto stamp = std::filesystem::last_write_time( _fn, ec );
+			auto size  = std::filesystem::file_size( _fn, ec );
+			if( ec || ( stamp == _stamp && size == _size ) )
+				return;
+			try
+			{
+				load();
+			}
+			catch( const std::exception& e )
+			{
+				std::cerr << "Error, unable to reload " << _fn << ": " << e.what() << '\n';
+				_stamp = stamp;
+				_size  = size;
+			}
+		}
+/// Writes in \c out the answer to \c query
+		void answer( std::string_view query, OutBuffer& out ) const
+		{
+			auto pos  = query.find( ' ' );
+			auto cmd  = query.substr( 0, pos );
+			auto name = ( pos == std::string_view::npos ? std::string_view() : query.substr( pos+1 ) );
+			uint32_t id = 0;
+
+			if( cmd == "E" || cmd == "M" )
+			{
+				bool byModule = ( cmd == "M" );
+				const auto& names = byModule ? _data._modules : _data._instructors;
+				if( !names.find( name, id ) )
+					return error( out, name, byModule );
+				const auto& rvm      = byModule ? _data._mod_prof : _data._prof_mod;
+				const auto& colNames = byModule ? _data._instructors : _data._modules;
+				auto row = ( byModule ? _moduleRow : _instructorRow )[id];
+				if( row == NoRow )               // no event in the selected weeks
+				{
+					out << "OK 1\ntotal" << g_ocs << Triplet() << '\n';
+					return;
+				}
+				OutBuffer lines;
+				for( auto k=rvm._rowStart[row]; k<rvm._rowStart[row+1]; k++ )
+					lines << colNames.name( rvm._colIds[k] ) << g_ocs << rvm._volumes[k] << '\n';
+				out << "OK " << rvm._rowStart[row+1] - rvm._rowStart[row] + 1 << '\n' << lines.str()
+					<< "total" << g_ocs << rvm._volumes.sum( rvm._rowStart[row], rvm._rowStart[row+1] ) << '\n';
+			}
+			else if( cmd == "JE" || cmd == "JM" )
+			{
+				bool byModule = ( cmd == "JM" );
+				if( !( byModule ? _data._modules : _data._instructors ).find( name, id ) )
+					return error( out, name, byModule );
+				const auto& data = ( byModule ? _data._moduleData : _data._instructorData )[id];
+				auto weeks       = ( byModule ? _data._moduleDays : _data._instructorDays )[id].weeks();
+				out << "OK 1\n" << data._nbDays << g_ocs << data._nbWeeks << g_ocs << data._volume << g_ocs;
+				for( size_t w=0; w<Presence::NbWeeks; w++ )
+					if( weeks & ( uint64_t(1) << w ) )
+						out << w << ( weeks >> w > 1 ? " " : "" );
+				out << '\n';
+			}
+			else if( cmd == "G" )
+			{
+				out << "OK " << _groups.size() << '\n';
+				for( const auto& grp: _groups )
+					out << grp.first << g_ocs << grp.second << '\n';
+			}
+			else if( cmd == "LE" || cmd == "LM" )
+			{
+				const auto& names = ( cmd == "LM" ? _data._modules : _data._instructors );
+				out << "OK " << names.size() << '\n';
+				for( auto i: names.sortedIds() )
+					out << names.name( i ) << '\n';
+			}
+			else
+				out << "ERR requete inconnue: " << query << '\n';
+		}
+
+	private:
+		void error( OutBuffer& out, std::string_view name, bool byModule ) const
+		{
+			out << "ERR " << ( byModule ? "module" : "enseignant" ) << " inconnu: " << name << '\n';
+		}
+/// Returns the label of the group of \c code for grouping key at position \c pos
+		static std::string groupLabel( std::string_view code, int pos, const std::map<char,std::string>& pairs )
+		{
+			if( pos < 0 || static_cast<size_t>(pos) >= code.size() )
+				return "?";
+			auto it = pairs.find( code[pos] );
+			return ( it == std::end(pairs) || it->second.empty() ) ? std::string( 1, code[pos] ) : it->second;
+		}
+		void load()
+		{
+			_stamp = std::filesystem::last_write_time( _fn );
+			_size  = std::filesystem::file_size( _fn );
+
+			MappedFile file( _fn );
+			Data data;
+			data.select( RP_All, _params.weekRange );
+			readInput( _fn, file.view(), _params, data, _nbThreads, _useSnapshot );
+
+			std::vector<size_t> instructorRow( data._instructors.size(), NoRow );
+			for( size_t row=0; row<data._prof_mod.nbRows(); row++ )
+				instructorRow[ data._prof_mod._rowIds[row] ] = row;
+			std::vector<size_t> moduleRow( data._modules.size(), NoRow );
+			for( size_t row=0; row<data._mod_prof.nbRows(); row++ )
+				moduleRow[ data._mod_prof._rowIds[row] ] = row;
+
+			std::map<std::string,Triplet> groups;
+			auto nbLevels = std::max( size_t(1), _params.nbGroupLevels() );
+			for( uint32_t id=0; id<data._modules.size(); id++ )
+			{
+				const auto& code = data._modules.name( id );
+				std::string label;
+				for( size_t lev=0; lev<nbLevels; lev++ )
+				{
+					const auto& level = _params.groupLevels[lev];
+					label += ( lev ? "/" : "" ) + groupLabel( code, level.pos, level.pairs );
+					groups[label] += data._moduleData[id]._volume;
+				}
+			}
+
+			_data          = std::move( data );
+			_instructorRow = std::move( instructorRow );
+			_moduleRow     = std::move( moduleRow );
+			_groups.assign( std::begin(groups), std::end(groups) );
+			std::cout << " - chargement de " << _fn << ": " << _data._instructors.size() << " enseignants, "
+				<< _data._modules.size() << " modules\n";
+		}
+
+		std::string _fn;
+		Params      _params;
+		size_t      _nbThreads;
+		bool        _useSnapshot;
+
+		std::filesystem::file_time_type _stamp;   ///< modification time of the input file when it was loaded
+		uintmax_t                       _size = 0;
+
+		Data                _data;
+/// Value of _instructorRow and _moduleRow for the resources that have no row, as they have no event in the selected weeks
+		static constexpr size_t NoRow = std::numeric_limits<size_t>::max();
+
+		std::vector<size_t> _instructorRow;     ///< row of each instructor ID in Data::_prof_mod, or NoRow
+		std::vector<size_t> _moduleRow;         ///< row of each module ID in Data::_mod_prof, or NoRow
+		std::vector<std::pair<std::string,Triplet>> _groups;   ///< volume of each group of modules, sorted by label
+};
+//-------------------------------------------------------------------
+/// Set by the signal handler to stop runServer()
+volatile std::sig_atomic_t g_stopServer = 0;
+
+/// Size of the answers waiting to be sent to a client above which its queries are not read anymore, see runServer()
+const size_t g_maxReplySize = 1 << 22;
+/// Maximum length of a query, a client that sends more without a newline character is disconnected, see runServer()
+const size_t g_maxQuerySize = 4096;
+
+extern "C" void onStopSignal( int )
+{
+	g_stopServer = 1;
+}
+//-------------------------------------------------------------------
+/// Loads \c fn_in and answers queries (see QueryServer) on Unix socket \c socketPath, until SIGINT or SIGTERM
+/**
+Several clients can be connected at the same time. The input file is checked every second, and reloaded if it has changed.
+The client sockets are non-blocking: the answers are buffered and sent when the client reads them,
+so that a slow client does not delay the other ones nor the reloads.
+A client that sends more than g_maxQuerySize bytes without a newline character gets an error, then is disconnected.
+When the snapshot is used, only the lines added to the file are parsed again (see readInput()).
+*/
+void
+runServer( std::string fn_in, const Params& params, size_t nbThreads, bool useSnapshot, std::string socketPath )
+{
+	QueryServer server( fn_in, params, nbThreads, useSnapshot );
+
+	sockaddr_un addr;
+	std::memset( &addr, 0, sizeof(addr) );
+	addr.sun_family = AF_UNIX;
+	if( socketPath.size() >= sizeof(addr.sun_path) )
+		throw std::runtime_error( "Error, socket path is too long: " + socketPath );
+	std::strcpy( addr.sun_path, socketPath.c_str() );
+
+	int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( fd < 0 )
+		throw std::runtime_error( "Error, unable to create socket: " + std::string( std::strerror(errno) ) );
+	::unlink( socketPath.c_str() );
+	if( bind( fd, reinterpret_cast<sockaddr*>( &addr ), sizeof(addr) ) != 0 || listen( fd, 16 ) != 0 )
+	{
+		::close( fd );
+		throw std::runtime_error( "Error, unable to listen on socket " + socketPath + ": " + std::strerror(errno) );
+	}
+	fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+	std::signal( SIGINT,  onStopSignal );
+	std::signal( SIGTERM, onStopSignal );
+	std::signal( SIGPIPE, SIG_IGN );
+	std::cout << " - en attente de requetes sur " << socketPath << '\n' << std::flush;
+
+	std::vector<pollfd>      fds( 1, pollfd{ fd, POLLIN, 0 } );
+	std::vector<std::string> pending( 1 );           // received data not yet answered, index: same as fds
+	std::vector<std::string> replies( 1 );           // answers not yet sent, index: same as fds
+	std::vector<char>        closing( 1 );           // 1: the connection is shut down once the answers are sent, 2: it is, the client input is discarded
+	OutBuffer out;
+	char buf[4096];
+	while( !g_stopServer )
+	{
+		for( size_t i=1; i<fds.size(); i++ )         // a client that does not read its answers is not read either
+			fds[i].events = ( replies[i].size() < g_maxReplySize ? POLLIN : 0 ) | ( replies[i].empty() ? 0 : POLLOUT );
+		if( poll( fds.data(), fds.size(), 1000 ) < 0 )
+		{
+			if( errno != EINTR )
+				throw std::runtime_error( "Error, poll failed: " + std::string( std::strerror(errno) ) );
+			continue;
+		}
+		server.reloadIfChanged();
+
+		for( size_t i=fds.size()-1; i>0; i-- )
+		{
+			if( !fds[i].revents )
+				continue;
+			bool gone = false;
+			if( fds[i].revents & ( POLLIN | POLLHUP | POLLERR ) )
+			{
+				auto nb = ::read( fds[i].fd, buf, sizeof(buf) );
+				if( nb > 0 && closing[i] )
+					;                                   // waiting for the client to close the connection
+				else if( nb > 0 )
+				{
+					auto& data = pending[i];
+					data.append( buf, nb );
+					size_t start = 0;
+					for( auto eol = data.find( '\n' ); eol != std::string::npos; eol = data.find( '\n', start ) )
+					{
+						auto query = std::string_view( data ).substr( start, eol-start );
+						if( !query.empty() && query.back() == '\r' )
+							query.remove_suffix( 1 );
+						server.answer( query, out );
+						start = eol+1;
+					}
+					data.erase( 0, start );
+					if( data.size() > g_maxQuerySize )
+					{
+						out << "ERR query too long\n";
+						data.clear();
+						closing[i] = 1;
+					}
+					replies[i].append( out.str() );
+					out.clear();
+				}
+				else
+					gone = ( nb == 0 || ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) );
+			}
+			if( !gone && !replies[i].empty() )          // sends what the socket accepts now, the rest when poll() gives POLLOUT
+			{
+				auto nbw = ::write( fds[i].fd, replies[i].data(), replies[i].size() );
+				if( nbw > 0 )
+					replies[i].erase( 0, nbw );
+				else if( nbw < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+					gone = true;
+			}
+			if( !gone && closing[i] == 1 && replies[i].empty() )    // closing the socket with unread input would drop the answers
+			{
+				::shutdown( fds[i].fd, SHUT_WR );
+				closing[i] = 2;
+			}
+			if( gone )
+			{
+				::close( fds[i].fd );
+				fds.erase( std::begin(fds) + i );
+				pending.erase( std::begin(pending) + i );
+				replies.erase( std::begin(replies) + i );
+				closing.erase( std::begin(closing) + i );
+			}
+		}
+		if( fds[0].revents & POLLIN )
+		{
+			int client = accept( fd, nullptr, nullptr );
+			if( client >= 0 )
+			{
+				fcntl( client, F_SETFL, fcntl( client, F_GETFL ) | O_NONBLOCK );
+				fds.push_back( pollfd{ client, POLLIN, 0 } );
+				pending.emplace_back();
+				replies.emplace_back();
+				closing.push_back( 0 );
+			}
+		}
+	}
+	for( const auto& pfd: fds )
+		::close( pfd.fd );
+	::unlink( socketPath.c_str() );
+	std::cout << " - arret du serveur\n";
+}
+#endif // ADEPOPRO_HAS_UNIX_SOCKET
+
+#ifndef ADEPOPRO_NO_MAIN      // defined when this file is included by the benchmark, see bench/adebench.cpp
+/// see adepopro.cpp
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 )
+	{
+		std::cout << "usage: " << argv[0] << " [options] <input_csv_file>\n"
+			<< "   or: " << argv[0] << " [options] --batch <input_csv_file|folder>...\n";
+		return 1;
+	}
+	std::string fn_in = argv[argc-1];
+	Params params( "adepopro.ini" ); // attemps to read in file, else keeps default values
+
+	bool printOptions = false;
+	bool useSnapshot  = true;
+	bool batchMode    = false;
+	bool combined     = false;
+	bool withStats    = false;
+	bool serve        = false;
+	std::string socketPath = "adepopro.sock";
+	std::string fn_before;
+	size_t nbThreads = 1;
+	size_t nbJobs    = std::max( 1u, std::thread::hardware_concurrency() );
+	std::vector<std::string> batchArgs;
+
+// in single-file mode the last argument is the input file, so it can not be the value of an option
+	int lastValue = ( std::find( argv+1, argv+argc, std::string( "--batch" ) ) != argv+argc ? argc : argc-1 );
+	auto nextValue = [&]( int& i )             // lambda
+	{
+		if( i+1 >= lastValue )
+			throw std::runtime_error( "Error, missing value for option " + std::string( argv[i] ) );
+		return std::string( argv[++i] );
+	};
+	if( argc > 1 )
+	{
+		for( int i=1; i<argc; i++ )
+		{
+			std::string arg( argv[i] );
+			if( arg == "-s" )
+				params.groupLevels[0].enabled = true;
+			else if( arg == "-p" )
+				printOptions = true;
+			else if( arg == "--no-cache" )
+				useSnapshot = false;
+			else if( arg == "--threads" )
+			{
+				nbThreads = std::stoul( nextValue( i ) );
+				if( nbThreads == 0 )
+					nbThreads = std::max( 1u, std::thread::hardware_concurrency() );
+			}
+			else if( arg == "--jobs" )
+				nbJobs = std::max( 1ul, std::stoul( nextValue( i ) ) );
+			else if( arg == "--combined" )
+				combined = true;
+			else if( arg == "--weeks" )
+				params.setWeekRange( nextValue( i ) );
+			else if( arg == "--conflicts" )
+				params.conflicts = true;
+			else if( arg == "--rooms" )
+				params.roomReport = true;
+			else if( arg == "--atomic" )
+				params.atomicWrite = true;
+			else if( arg.rfind( "--reports=", 0 ) == 0 )
+				params.setReports( arg.substr( 10 ) );
+			else if( arg == "--stats" )
+				withStats = true;
+			else if( arg == "--serve" )
+				serve = true;
+			else if( arg == "--socket" )
+				socketPath = nextValue( i );
+			else if( arg == "--diff" )
+				fn_before = nextValue( i );
+			else if( arg == "--batch" )
+				batchMode = true;
+			else if( batchMode && !arg.empty() && arg.front() != '-' )
+				batchArgs.push_back( arg );
+		}
+	}
+	if( printOptions )
+	{
+		std::cout << argv[0] << ", version date: " << __DATE__
+			<< '\n' << params << '\n';
+		return 1;
+	}
+
+	if( batchMode )
+	{
+		auto v_fn = listInputFiles( batchArgs );
+		if( v_fn.empty() )
+			throw std::runtime_error( "Error, no input file given for batch mode" );
+		return processBatch( v_fn, params, nbJobs, useSnapshot, combined, withStats ) ? 1 : 0;
+	}
+
+	if( !fn_before.empty() )
+	{
+		processDiff( fn_before, fn_in, params, nbThreads, useSnapshot );
+		return 0;
+	}
+
+	if( serve )
+	{
+#ifdef ADEPOPRO_HAS_UNIX_SOCKET
+		runServer( fn_in, params, nbThreads, useSnapshot, socketPath );
+		return 0;
+#else
+		throw std::runtime_error( "Error, option --serve is not available on this platform" );
+#endif
+	}
+	processFile( fn_in, params, nbThreads, useSnapshot, withStats );
 }
+#endif // ADEPOPRO_NO_MAIN
 //-------------------------------------------------------------------
 
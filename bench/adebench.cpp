@@ -0,0 +1,194 @@
+/**
+\file adebench.cpp
+\brief Benchmark of adepopro: times each processing stage on a given input file (see adegen.cpp and "make bench")
+
+- Author: S. Kramm - 2018
+- Licence: GPL v3.0
+- hosting: https://github.com/skramm/adepopro
+
+usage: adebench [-c file.ini] [-s] [--threads N] input_file.csv
+
+The stages are timed separately, in the same order as in processFile():
+ - \c map          : mapping the input file and touching every page
+ - \c parse        : parseData() only, the events are stored in a vector
+ - \c addOne       : Data::addOne() called on the stored events
+ - \c compute      : Data::compute()
+ - \c readData_mt  : readData_mt() + Data::compute() on a new Data, with the given thread count
+ - \c writeCsv_E, \c writeCsv_M, \c writeReport_ME, \c writeReport_EM : output files
+
+The number of calls to the global allocator is counted for each stage (\c allocs), with the peak resident memory of the whole run (\c peak_rss_kb).
+The results are printed as a single JSON line on standard output, so they can be appended to a file and compared between versions.
+The output files are written in the current folder.
+*/
+
+#define ADEPOPRO_NO_MAIN
+#include "../adepopro.cpp"
+
+#include <chrono>
+#include <new>
+#include <cstdlib>
+
+#ifndef ADEPOPRO_VERSION
+	#define ADEPOPRO_VERSION "unknown"
+#endif
+
+//-------------------------------------------------------------------
+/// An event, as given by parseData()
+struct Event
+{
+	std::string_view                            _instr;
+	size_t                                      _week;
+	EN_WeekDay                                  _wd;
+	std::pair<EN_CourseType,std::string_view>   _typeMod;
+	float                                       _duration;
+};
+
+//-------------------------------------------------------------------
+/// Number of calls to the global allocator, see operator new below
+std::atomic<size_t> g_nbAllocs{ 0 };
+
+void*
+operator new( size_t size )
+{
+	g_nbAllocs.fetch_add( 1, std::memory_order_relaxed );
+	if( void* p = std::malloc( size ? size : 1 ) )
+		return p;
+	throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void       // not inlined: the compiler would see free() on memory returned by new
+operator delete( void* p ) noexcept
+{
+	std::free( p );
+}
+
+__attribute__((noinline)) void
+operator delete( void* p, size_t ) noexcept
+{
+	std::free( p );
+}
+
+//-------------------------------------------------------------------
+/// A timed stage
+struct Stage
+{
+	std::string _name;
+	double      _seconds;   ///< elapsed wall time
+	size_t      _allocs;    ///< number of calls to the global allocator
+};
+
+/// Runs \c f and returns its elapsed wall time and number of allocations
+template<typename FUNC>
+Stage
+runStage( std::string name, FUNC&& f )
+{
+	auto nb = g_nbAllocs.load();
+	auto t0 = std::chrono::steady_clock::now();
+	f();
+	double elapsed = std::chrono::duration<double>( std::chrono::steady_clock::now() - t0 ).count();
+	return Stage{ name, elapsed, g_nbAllocs.load() - nb };
+}
+
+//-------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 )
+	{
+		std::cerr << "usage: " << argv[0] << " [-c file.ini] [-s] [--threads N] <input_csv_file>\n";
+		return 1;
+	}
+	std::string fn_in = argv[argc-1];
+	std::string fn_ini;
+	bool groupKey1 = false;
+	size_t nbThreads = std::max( 1u, std::thread::hardware_concurrency() );
+	for( int i=1; i<argc-1; i++ )
+	{
+		std::string arg( argv[i] );
+		if( arg == "-c" && i+1 < argc-1 )
+			fn_ini = argv[++i];
+		else if( arg == "-s" )
+			groupKey1 = true;
+		else if( arg == "--threads" && i+1 < argc-1 )
+			nbThreads = std::max( 1ul, std::stoul( argv[++i] ) );
+	}
+	Params params = fn_ini.empty() ? Params() : Params( fn_ini );
+	params.groupLevels[0].enabled = params.groupLevels[0].enabled || groupKey1;
+
+	std::vector<Stage> stages;
+	std::string head1 = "# Nom;Nb jours;Nb sem;vol. CM;vol. TD;vol. TP;vol. total;";
+
+	std::unique_ptr<MappedFile> file;
+	volatile char sink = 0;
+	stages.push_back( runStage( "map", [&]
+		{
+			file.reset( new MappedFile( fn_in ) );
+			for( size_t i=0; i<file->view().size(); i+=4096 )
+				sink = file->view()[i];
+		} ) );
+	auto content = file->view();
+
+	std::vector<Event> events;
+	stages.push_back( runStage( "parse", [&]
+		{
+			parseData(
+				content,
+				params,
+				[&events]
+				( std::string_view instr, size_t num_sem, EN_WeekDay wd, const std::pair<EN_CourseType,std::string_view>& type_mod, float duration )
+				{
+					events.push_back( Event{ instr, num_sem, wd, type_mod, duration } );
+				}
+			);
+		} ) );
+
+	Data results;
+	stages.push_back( runStage( "addOne", [&]
+		{
+			for( const auto& ev: events )
+				results.addOne( ev._instr, ev._week, ev._wd, ev._typeMod, ev._duration );
+		} ) );
+	stages.push_back( runStage( "compute", [&]{ results.compute(); } ) );
+
+	stages.push_back( runStage( "readData_mt", [&]
+		{
+			Data other;
+			readData_mt( content, params, other, nbThreads );
+			other.compute();
+		} ) );
+
+	params.assignFileName( fn_in );
+	stages.push_back( runStage( "writeCsv_E", [&]
+		{ results.writeCsv( "adepopro_E_", results._instructorData, results._instructors, head1 + "nb modules", params ).close(); } ) );
+	stages.push_back( runStage( "writeCsv_M", [&]
+		{ results.writeCsv( "adepopro_M_", results._moduleData, results._modules, head1 + "nb enseignants", params ).close(); } ) );
+	stages.push_back( runStage( "writeReport_ME", [&]{ results.writeReport_MI( "adepopro_ME_", params ).close(); } ) );
+	stages.push_back( runStage( "writeReport_EM", [&]{ results.writeReport_IM( "adepopro_EM_", params ).close(); } ) );
+
+	OutBuffer fileName;
+	printJsonString( fileName, fn_in );
+	std::ostringstream oss;
+	oss << "{\"version\":\"" << ADEPOPRO_VERSION << "\",\"file\":" << fileName.str()
+		<< ",\"bytes\":" << content.size() << ",\"rows\":" << events.size()
+		<< ",\"instructors\":" << results._instructors.size() << ",\"modules\":" << results._modules.size()
+		<< ",\"threads\":" << nbThreads << ",\"stages\":{";
+	double total = 0.;
+	size_t nbAllocs = 0;
+	for( size_t i=0; i<stages.size(); i++ )
+	{
+		oss << ( i ? "," : "" ) << '"' << stages[i]._name << "\":" << stages[i]._seconds;
+		if( stages[i]._name != "readData_mt" )
+		{
+			total    += stages[i]._seconds;
+			nbAllocs += stages[i]._allocs;
+		}
+	}
+	oss << "},\"allocs\":{";
+	for( size_t i=0; i<stages.size(); i++ )
+		oss << ( i ? "," : "" ) << '"' << stages[i]._name << "\":" << stages[i]._allocs;
+	oss << "},\"total\":" << total << ",\"total_allocs\":" << nbAllocs
+		<< ",\"rows_per_s\":" << ( total > 0. ? events.size() / total : 0. )
+		<< ",\"peak_rss_kb\":" << getPeakRss() << "}";
+	std::cout << oss.str() << std::endl;
+	(void)sink;
+}
+//-------------------------------------------------------------------
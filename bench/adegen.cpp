@@ -0,0 +1,186 @@
+/**
+\file adegen.cpp
+\brief Generates a synthetic ADE Campus export, for benchmarking adepopro (see adebench.cpp and "make bench")
+
+- Author: S. Kramm - 2018
+- Licence: GPL v3.0
+- hosting: https://github.com/skramm/adepopro
+
+The generated file has the same layout as the files exported from ADE
+(see sample_input.csv and the default column indexes in adepopro.cpp).
+
+Module codes are of the form \c ABCxSUn... + course-type character, where \c S (semester, 1 to 4)
+and \c U (teaching unit, 1 or 2) are at positions 4 and 5, so they can be used for grouping (see adepopro.ini).
+Each module is taught by 1 to 3 instructors.
+
+Command-line options:
+ - "-n N"        : number of rows (default: 10000)
+ - "-i N"        : number of instructors (default: rows/200, at least 10)
+ - "-m N"        : number of modules (default: rows/100, at least 10)
+ - "-w N"        : number of weeks (default: 40)
+ - "-t C:D:P"    : relative frequencies of CM, TD and TP sessions (default: 2:3:5)
+ - "-r N"        : random seed (default: 1), the same seed always gives the same file
+ - "-o file"     : output file (default: standard output)
+*/
+
+#include <vector>
+#include <array>
+#include <string>
+#include <random>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+const std::array<const char*,5> g_days = { "Lundi", "Mardi", "Mercredi", "Jeudi", "Vendredi" };
+
+const std::vector<std::string> g_firstNames = {
+	"Brad", "David", "Hugh", "James", "John", "Tina", "Marie", "Jérôme", "Élodie", "Paul",
+	"Anne", "Louis", "Chloé", "Hélène", "Marc", "Sophie", "Luc", "Inès", "Hugo", "Zoé"
+};
+const std::vector<std::string> g_lastNames = {
+	"Pitt", "Bowie", "Grant", "Brown", "Dean", "Doe", "Turner", "Travolta", "Martin", "Bernard",
+	"Dubois", "Thomas", "Robert", "Richard", "Petit", "Durand", "Leroy", "Moreau", "Simon", "Laurent"
+};
+const std::vector<std::string> g_rooms = { "Amphi", "A-06", "A-102", "A-203", "A-204", "A-206", "A-207", "B-12", "C-101" };
+
+/// Course type characters and labels, same order as EN_CourseType in adepopro.cpp
+const std::array<char,3>        g_typeChar  = { 'C', 'D', 'P' };
+const std::array<const char*,3> g_typeLabel = { "CM", "TD", "TP" };
+
+//-------------------------------------------------------------------
+/// Holds the generation parameters
+struct GenParams
+{
+	size_t nbRows    = 10000;
+	size_t nbInstr   = 0;
+	size_t nbModules = 0;
+	size_t nbWeeks   = 40;
+	std::array<double,3> typeMix = { 2., 3., 5. };
+	unsigned    seed = 1;
+	std::string outFile;
+};
+
+//-------------------------------------------------------------------
+/// A generated module, with the instructors affected to it
+struct Module
+{
+	std::string      code;   ///< without the course-type character
+	std::vector<int> instr;  ///< instructor indexes
+};
+
+//-------------------------------------------------------------------
+/// Returns the date (as "dd/mm/yyyy") of day \c wd (0 is monday) of week \c week, week 1 starting on monday 01/01/2018
+std::string
+getDate( size_t week, size_t wd )
+{
+	static const std::array<int,12> monthSize = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	int day  = static_cast<int>( (week-1)*7 + wd );
+	int year = 2018;
+	while( day >= 365 )
+	{
+		day -= 365;
+		year++;
+	}
+	int month = 0;
+	while( day >= monthSize[month] )
+		day -= monthSize[month++];
+	char buf[32];
+	std::snprintf( buf, sizeof(buf), "%02d/%02d/%d", day+1, month+1, year );
+	return buf;
+}
+//-------------------------------------------------------------------
+void
+generate( const GenParams& gp, std::ostream& out )
+{
+	std::mt19937_64 rng( gp.seed );
+	auto randInt = [&rng]( size_t n ) { return std::uniform_int_distribution<size_t>( 0, n-1 )( rng ); };
+
+	std::vector<std::string> instr( gp.nbInstr );
+	for( size_t i=0; i<instr.size(); i++ )
+		instr[i] = g_firstNames[ i % g_firstNames.size() ] + ' ' + g_lastNames[ (i / g_firstNames.size()) % g_lastNames.size() ]
+			+ ( i < g_firstNames.size() * g_lastNames.size() ? "" : " " + std::to_string( i ) );
+
+	std::vector<Module> modules( gp.nbModules );
+	for( size_t i=0; i<modules.size(); i++ )
+	{
+		auto& mod = modules[i];
+		mod.code = "ABC" + std::to_string( i % 10 ) + std::to_string( 1 + randInt(4) ) + std::to_string( 1 + randInt(2) ) + std::to_string( i / 10 );
+		size_t nb = 1 + randInt( 3 );
+		for( size_t j=0; j<nb; j++ )
+			mod.instr.push_back( static_cast<int>( randInt( gp.nbInstr ) ) );
+	}
+
+	std::discrete_distribution<int> typeDist( std::begin(gp.typeMix), std::end(gp.typeMix) );
+	const std::array<int,3> duration = { 90, 90, 180 };   // in minutes, for CM, TD, TP
+
+	out << "#;;;;;nom;salle;mod;\n";
+	for( size_t row=0; row<gp.nbRows; row++ )
+	{
+		const auto& mod = modules[ randInt( modules.size() ) ];
+		auto type  = typeDist( rng );
+		auto week  = 1 + randInt( gp.nbWeeks );
+		auto wd    = randInt( g_days.size() );
+		int  dur   = duration[type] + ( randInt(4) == 0 ? 30 : 0 );
+		int  start = 8*60 + 30*static_cast<int>( randInt( 18 ) );
+		int  end   = start + dur;
+
+		std::string name;
+		if( randInt( 100 ) != 0 )     // 1% of events have no instructor
+			name = instr[ mod.instr[ randInt( mod.instr.size() ) ] ];
+
+		char times[64];
+		std::snprintf( times, sizeof(times), "%02dh%02d;%02dh%02d;%02dh%02d", dur/60, dur%60, start/60, start%60, end/60, end%60 );
+		out << "Semaine " << week << ';' << g_days[wd] << ' ' << getDate( week, wd ) << ';' << times << ';'
+			<< mod.code << ' ' << g_typeLabel[type] << " Enseignement;" << name << ';' << g_rooms[ randInt( g_rooms.size() ) ] << ';'
+			<< mod.code << g_typeChar[type] << ";\n";
+	}
+}
+//-------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+	GenParams gp;
+	for( int i=1; i<argc; i++ )
+	{
+		std::string arg( argv[i] );
+		if( i+1 >= argc )
+			throw std::runtime_error( "Error, missing value for option " + arg );
+		std::string val( argv[++i] );
+		if( arg == "-n" )
+			gp.nbRows = std::stoul( val );
+		else if( arg == "-i" )
+			gp.nbInstr = std::stoul( val );
+		else if( arg == "-m" )
+			gp.nbModules = std::stoul( val );
+		else if( arg == "-w" )
+			gp.nbWeeks = std::stoul( val );
+		else if( arg == "-r" )
+			gp.seed = std::stoul( val );
+		else if( arg == "-o" )
+			gp.outFile = val;
+		else if( arg == "-t" )
+		{
+			if( std::sscanf( val.c_str(), "%lf:%lf:%lf", &gp.typeMix[0], &gp.typeMix[1], &gp.typeMix[2] ) != 3 )
+				throw std::runtime_error( "Error, invalid course type mix: " + val );
+		}
+		else
+			throw std::runtime_error( "Error, unknown option " + arg );
+	}
+	if( gp.nbInstr == 0 )
+		gp.nbInstr = std::max( gp.nbRows / 200, size_t(10) );
+	if( gp.nbModules == 0 )
+		gp.nbModules = std::max( gp.nbRows / 100, size_t(10) );
+	if( gp.nbWeeks == 0 || gp.nbWeeks > 53 )
+		throw std::runtime_error( "Error, number of weeks must be between 1 and 53" );
+
+	if( gp.outFile.empty() )
+		generate( gp, std::cout );
+	else
+	{
+		std::ofstream out( gp.outFile );
+		if( !out.is_open() )
+			throw std::runtime_error( "Error, unable to open file " + gp.outFile );
+		generate( gp, out );
+	}
+}
+//-------------------------------------------------------------------